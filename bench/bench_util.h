@@ -0,0 +1,49 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+// Timing and result checks shared by the benchmarks in this directory
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// Wall time of one call of fn in milliseconds
+template <typename Fn>
+double timeOnce(Fn fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Best-of-N wall time of fn in milliseconds
+template <typename Fn>
+double timeBest(int runs, Fn fn) {
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        best = std::min(best, timeOnce(fn));
+    }
+    return best;
+}
+
+// Difference from the expected value, relative to its magnitude once that exceeds one
+double relativeError(double value, double expected) {
+    return std::fabs(value - expected) / std::max(1.0, std::fabs(expected));
+}
+
+/**
+ * Prints the outcome of a correctness check.
+ * @param failure What went wrong, printed after "FAILED: "
+ * @return The process exit code
+ */
+int reportCheck(bool passed, const char* failure) {
+    if (!passed) {
+        printf("FAILED: %s\n", failure);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
+
+#endif // BENCH_UTIL_H
@@ -0,0 +1,96 @@
+// Compares the mesh cache codec against plain binary and gzip (zlib) on OFF models.
+// Usage: ./codec_bench <mesh_file.off> [more.off ...]
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <zlib.h>
+
+#include "OFFReader.h"
+#include "bench_util.h"
+#include "mesh_codec.h"
+
+void printRow(const char* name, size_t bytes, size_t rawBytes, double encodeMs, double decodeMs) {
+    printf("  %-8s %12zu bytes  %6.1f%%  encode %8.2f ms  decode %8.2f ms  %7.2f GB/s\n",
+           name, bytes, 100.0 * bytes / rawBytes, encodeMs, decodeMs,
+           decodeMs > 0.0 ? rawBytes / (decodeMs * 1e6) : 0.0);
+}
+
+int benchModel(char* path) {
+    OffModel* model = readOffFile(path);
+    if (!model) return 1;
+
+    std::vector<uint32_t> positions(model->numberOfVertices * 3);
+    for (int i = 0; i < model->numberOfVertices; i++) {
+        memcpy(&positions[3 * i], &model->vertices[i].x, 3 * sizeof(float));
+    }
+    std::vector<unsigned int> indices;
+    for (int i = 0; i < model->numberOfPolygons; i++) {
+        for (int j = 1; j < model->polygons[i].noSides - 1; j++) {
+            indices.push_back(model->polygons[i].v[0]);
+            indices.push_back(model->polygons[i].v[j]);
+            indices.push_back(model->polygons[i].v[j + 1]);
+        }
+    }
+    size_t vertexBytes = positions.size() * sizeof(uint32_t);
+    size_t indexBytes = indices.size() * sizeof(unsigned int);
+    size_t rawBytes = vertexBytes + indexBytes;
+    const int runs = 10;
+
+    printf("%s: %d vertices, %zu triangles\n", path, model->numberOfVertices, indices.size() / 3);
+
+    // Plain binary: decoding is a copy
+    std::vector<unsigned char> raw(rawBytes), rawOut(rawBytes);
+    memcpy(raw.data(), positions.data(), vertexBytes);
+    memcpy(raw.data() + vertexBytes, indices.data(), indexBytes);
+    double rawMs = timeBest(runs, [&] { memcpy(rawOut.data(), raw.data(), rawBytes); });
+    printRow("binary", rawBytes, rawBytes, 0.0, rawMs);
+
+    // Mesh codec
+    std::vector<unsigned char> vertexData, indexData;
+    double encodeMs = timeBest(1, [&] {
+        vertexData = encodeVertexStream(positions.data(), model->numberOfVertices, 3);
+        indexData = encodeIndexBuffer(indices.data(), indices.size());
+    });
+    std::vector<uint32_t> positionsOut(positions.size());
+    std::vector<unsigned int> indicesOut(indices.size());
+    bool ok = true;
+    double decodeMs = timeBest(runs, [&] {
+        ok &= decodeVertexStream(positionsOut.data(), model->numberOfVertices, 3, vertexData.data(), vertexData.size());
+        ok &= decodeIndexBuffer(indicesOut.data(), indicesOut.size(), indexData.data(), indexData.size());
+    });
+    ok = ok && positionsOut == positions && indicesOut == indices;
+    printRow("codec", vertexData.size() + indexData.size(), rawBytes, encodeMs, decodeMs);
+    printf("           vertices %zu bytes, indices %zu bytes (%.2f bytes/triangle)%s\n",
+           vertexData.size(), indexData.size(), indexData.size() / (indices.size() / 3.0),
+           ok ? "" : "  ROUND TRIP MISMATCH");
+
+    // gzip (zlib deflate, default level)
+    uLongf gzipBytes = compressBound(rawBytes);
+    std::vector<unsigned char> gzipData(gzipBytes);
+    double gzipEncodeMs = timeBest(1, [&] {
+        gzipBytes = compressBound(rawBytes);
+        compress2(gzipData.data(), &gzipBytes, raw.data(), rawBytes, Z_DEFAULT_COMPRESSION);
+    });
+    double gzipDecodeMs = timeBest(runs, [&] {
+        uLongf outBytes = rawBytes;
+        uncompress(rawOut.data(), &outBytes, gzipData.data(), gzipBytes);
+    });
+    printRow("gzip", gzipBytes, rawBytes, gzipEncodeMs, gzipDecodeMs);
+
+    FreeOffModel(model);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <mesh_file.off> [more.off ...]\n", argv[0]);
+        return 1;
+    }
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++) {
+        failures += benchModel(argv[i]);
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+// Microbenchmark and correctness check for the CPU explosion kernel.
+// Compares the scalar reference loop, the SIMD kernel on one thread and the pooled
+// updateExplosion, and fails if any result drifts from the reference.
+// Usage: ./explosion_bench [corner count] [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "bench_util.h"
+#include "explosion_effect.h"
+
+// Scalar reference: the evaluation loop updateExplosion used before vectorisation
+void referenceExplosion(const ExplosionState& state, float distance, ExplodedPositions& out) {
+    for (size_t i = 0; i < state.size(); i++) {
+        out.x[i] = state.originalX[i] + state.directionX[i] * distance;
+        out.y[i] = state.originalY[i] + state.directionY[i] * distance;
+        out.z[i] = state.originalZ[i] + state.directionZ[i] * distance;
+    }
+}
+
+// Largest relative error of b against the reference positions a
+double maxRelativeError(const ExplodedPositions& a, const ExplodedPositions& b) {
+    double worst = 0.0;
+    for (size_t i = 0; i < a.size(); i++) {
+        worst = std::max(worst, relativeError(b.x[i], a.x[i]));
+        worst = std::max(worst, relativeError(b.y[i], a.y[i]));
+        worst = std::max(worst, relativeError(b.z[i], a.z[i]));
+    }
+    return worst;
+}
+
+void report(const char* name, double ms, size_t count) {
+    // Six floats read and three written per corner
+    double bytes = count * 9.0 * sizeof(float);
+    printf("  %-22s %8.3f ms  %7.2f GB/s  %7.1f M corners/s\n", name, ms, bytes / (ms * 1e6), count / (ms * 1e3));
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 4000000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 20;
+    if (count == 0 || iterations <= 0) {
+        printf("Usage: %s [corner count] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    // Random positions with unit directions, as Mesh produces them
+    ExplosionState state;
+    state.resize(count);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 position(uniform(rng), uniform(rng), uniform(rng));
+        glm::vec3 direction(uniform(rng), uniform(rng), uniform(rng));
+        float length = glm::length(direction);
+        direction = length > 0.0001f ? direction / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        state.set(i, position, direction);
+    }
+    ExplosionHandle handle = explosionRegistry.create(std::move(state));
+    const ExplosionState& registered = *explosionRegistry.get(handle);
+
+    ExplodedPositions reference, single, pooled;
+    reference.resize(count);
+    single.resize(count);
+    pooled.resize(count);
+    const float distance = 0.75f;
+
+    printf("%zu corners, %d iterations, %u threads\n", count, iterations, threadPool().size());
+
+    double referenceMs = timeBest(iterations, [&] { referenceExplosion(registered, distance, reference); });
+    report("scalar reference", referenceMs, count);
+
+    double singleMs = timeBest(iterations, [&] {
+        explodeComponent(registered.originalX.data(), registered.directionX.data(), distance, single.x.data(), 0, count);
+        explodeComponent(registered.originalY.data(), registered.directionY.data(), distance, single.y.data(), 0, count);
+        explodeComponent(registered.originalZ.data(), registered.directionZ.data(), distance, single.z.data(), 0, count);
+    });
+    report("SIMD, one thread", singleMs, count);
+
+    double pooledMs = timeBest(iterations, [&] {
+        updateExplosion(handle, distance, pooled.x.data(), pooled.y.data(), pooled.z.data());
+    });
+    report("SIMD, thread pool", pooledMs, count);
+
+    // Fused multiply-add rounds once, so allow a couple of ulps against the reference
+    const double tolerance = 1e-6;
+    double singleError = maxRelativeError(reference, single);
+    double pooledError = maxRelativeError(reference, pooled);
+    printf("  max relative error: one thread %.3g, pool %.3g (tolerance %.1g)\n", singleError, pooledError, tolerance);
+
+    return reportCheck(singleError <= tolerance && pooledError <= tolerance,
+                       "SIMD kernel does not match the scalar reference");
+}
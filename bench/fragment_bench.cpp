@@ -0,0 +1,102 @@
+// Microbenchmark and correctness check for the rigid-fragment simulation.
+// Times FragmentSimulation::step on a synthetic assembly against a scalar reference
+// integration and fails if the transforms drift from the reference.
+// Usage: ./fragment_bench [fragment count] [steps]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "bench_util.h"
+#include "fragment_simulation.h"
+
+// Scalar reference with the same semi-implicit Euler step and ground contact
+struct ReferenceFragment {
+    glm::vec3 offset = glm::vec3(0.0f), velocity = glm::vec3(0.0f);
+    float angle = 0.0f, spin = 0.0f, restOffsetY = 0.0f;
+};
+
+void referenceStep(std::vector<ReferenceFragment>& fragments, const FragmentSimulation& simulation,
+                   float dt, float meshRadius) {
+    dt = std::min(dt, simulation.maxStep);
+    float gravityStep = -simulation.gravity * meshRadius * dt;
+    float damping = std::pow(simulation.contactDamping, dt * 60.0f);
+    for (ReferenceFragment& f : fragments) {
+        f.velocity.y += gravityStep;
+        f.offset += f.velocity * dt;
+        f.angle += f.spin * dt;
+        if (f.offset.y < f.restOffsetY) {
+            f.offset.y = f.restOffsetY;
+            if (f.velocity.y < 0.0f) f.velocity.y *= -simulation.restitution;
+            f.velocity.x *= damping;
+            f.velocity.z *= damping;
+            f.spin *= damping;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? atoi(argv[1]) : 50000;
+    int steps = argc > 2 ? atoi(argv[2]) : 600;
+    if (count <= 0 || steps <= 0) {
+        printf("Usage: %s [fragment count] [steps]\n", argv[0]);
+        return 1;
+    }
+
+    // Parts scattered in a unit sphere, flying away from its center
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::vector<glm::vec3> centers(count), directions(count);
+    std::vector<float> radii(count);
+    for (int i = 0; i < count; i++) {
+        centers[i] = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        float length = glm::length(centers[i]);
+        directions[i] = length > 0.0001f ? centers[i] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        radii[i] = 0.01f + 0.02f * (uniform(rng) + 1.0f);
+    }
+    const float meshRadius = 1.0f;
+    const float groundY = -1.0f;
+    const float dt = 1.0f / 60.0f;
+
+    FragmentSimulation simulation;
+    simulation.init(centers, radii, groundY);
+    simulation.launch(directions, meshRadius);
+
+    // The reference starts from the same launch state
+    std::vector<ReferenceFragment> reference(count);
+    for (int i = 0; i < count; i++) {
+        float speed = meshRadius * simulation.launchSpeed * (0.5f + partRandom(i, 6));
+        reference[i].velocity = directions[i] * speed;
+        reference[i].velocity.y += meshRadius * simulation.launchLift * partRandom(i, 7);
+        reference[i].spin = simulation.maxSpin * (2.0f * partRandom(i, 5) - 1.0f);
+        reference[i].restOffsetY = groundY + radii[i] - centers[i].y;
+    }
+
+    printf("%d fragments, %d steps, %u threads\n", count, steps, threadPool().size());
+
+    // Stepping ends early once the simulation reports every fragment at rest
+    double totalMs = 0.0, worstMs = 0.0;
+    int taken = 0;
+    for (; taken < steps && simulation.running; taken++) {
+        double ms = timeOnce([&] { simulation.step(dt); });
+        totalMs += ms;
+        worstMs = std::max(worstMs, ms);
+        referenceStep(reference, simulation, dt, meshRadius);
+    }
+    printf("  step: mean %.3f ms, worst %.3f ms (budget 1 ms)\n", totalMs / std::max(taken, 1), worstMs);
+    if (!simulation.running) printf("  at rest after %d steps\n", taken);
+
+    double worstError = 0.0;
+    const std::vector<glm::vec4>& transforms = simulation.getTransforms();
+    for (int i = 0; i < count; i++) {
+        glm::vec4 expected(reference[i].offset, reference[i].angle);
+        for (int c = 0; c < 4; c++) {
+            worstError = std::max(worstError, relativeError(transforms[i][c], expected[c]));
+        }
+    }
+    const double tolerance = 1e-4;
+    printf("  max relative error against the reference: %.3g (tolerance %.1g)\n", worstError, tolerance);
+
+    return reportCheck(worstError <= tolerance, "simulation does not match the scalar reference");
+}
@@ -0,0 +1,60 @@
+// Correctness check and timing for the incremental vertex normal update.
+// Applies sculpting strokes through Mesh::setVertexPosition and commitVertexEdits, each
+// moving a vertex and its one-ring along their normals, then fails if the normals differ
+// from a full recompute of the edited mesh. Runs without a GL context.
+// Usage: ./normals_bench <mesh_file.off> [strokes]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench_util.h"
+#include "mesh.h"
+
+int main(int argc, char* argv[]) {
+    int strokes = argc > 2 ? atoi(argv[2]) : 1000;
+    if (argc < 2 || strokes <= 0) {
+        printf("Usage: %s <mesh_file.off> [strokes]\n", argv[0]);
+        return 1;
+    }
+
+    Mesh mesh(argv[1]);
+    float distance = 0.02f * mesh.boundingSphereRadius;
+    printf("%s: %zu vertices, %zu triangles, %d parts, %d strokes\n", argv[1], mesh.vertices.size(),
+           mesh.indices.size() / 3, mesh.parts.numParts, strokes);
+
+    double commitMs = 0.0;
+    size_t moved = 0;
+    std::vector<unsigned int> stroke;
+    for (int s = 0; s < strokes; s++) {
+        unsigned int center = (unsigned int)(partRandom(s, 8) * mesh.vertices.size());
+        stroke.assign(1, center);
+        mesh.topology.forEachOneRing(center, [&](int u) {
+            if (std::find(stroke.begin(), stroke.end(), (unsigned int)u) == stroke.end()) stroke.push_back(u);
+        });
+        for (size_t i = 0; i < stroke.size(); i++) {
+            const MeshVertex& vertex = mesh.vertices[stroke[i]];
+            mesh.setVertexPosition(stroke[i], vertex.position + vertex.normal * (i == 0 ? distance : 0.5f * distance));
+        }
+        moved += stroke.size();
+        commitMs += timeOnce([&] { mesh.commitVertexEdits(); });
+    }
+
+    std::vector<MeshVertex> reference(mesh.vertices);
+    double fullMs = timeOnce([&] {
+        accumulateVertexNormals(reference.data(), reference.size(), mesh.indices.data(), mesh.indices.size());
+    });
+    printf("  commit: mean %.4f ms for %.1f moved vertices, full recompute %.3f ms\n", commitMs / strokes,
+           (double)moved / strokes, fullMs);
+
+    double worstError = 0.0;
+    for (size_t i = 0; i < reference.size(); i++) {
+        for (int c = 0; c < 3; c++) {
+            worstError = std::max(worstError, relativeError(mesh.vertices[i].normal[c], reference[i].normal[c]));
+        }
+    }
+    const double tolerance = 1e-5;
+    printf("  max error against a full recompute: %.3g (tolerance %.1g)\n", worstError, tolerance);
+
+    return reportCheck(worstError <= tolerance, "incremental normals do not match a full recompute");
+}
@@ -5,25 +5,31 @@ in vec3 FragPos;
 in vec3 Normal;
 in float Depth;
 
-uniform vec3 viewPos;
-uniform bool useDepthColor;
-uniform float minDepth;
-uniform float maxDepth;
+// Shared blocks, see uniform_blocks.h for the matching C++ layouts
+layout (std140) uniform FrameBlock {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float minDepth;
+    float maxDepth;
+};
 
-struct Light {
-    vec3 position;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    bool enabled;
+// Clustered lighting, see clustered_lighting.h
+layout (std140) uniform LightBlock {
+    uvec4 clusterDims;   // Froxel grid x, y, z and the number of lights
+    vec4 clusterScale;   // Viewport width, height, depth slice scale and bias
 };
 
-#define NR_LIGHTS 3
-uniform Light lights[NR_LIGHTS];
+uniform samplerBuffer lightData;      // 4 texels per light: position + radius, ambient, diffuse, specular
+uniform usamplerBuffer clusterGrid;   // (first index, count) per froxel
+uniform usamplerBuffer clusterLights; // Light indices of all froxels
 
-uniform vec3 objectColor;
-uniform float shininess;
+layout (std140) uniform MaterialBlock {
+    vec3 objectColor;
+    float shininess;
+};
 
+#ifdef DEPTH_COLOR
 vec3 getDepthColor(float depth) {
     // Normalize depth to 0-1 range
     float normalizedDepth = clamp((depth - minDepth) / (maxDepth - minDepth), 0.0, 1.0);
@@ -43,39 +49,52 @@ vec3 getDepthColor(float depth) {
         return mix(vec3(1.0, 0.0, 0.0), vec3(1.0, 0.3, 0.0), (normalizedDepth - 0.67) / 0.33);
     }
 }
+#endif
 
 void main() {
-    // If depth coloring is enabled
-    vec3 finalColor;
-    if (useDepthColor) {
-        finalColor = getDepthColor(Depth);
-    } else {
-        finalColor = objectColor;
-    }
+    // DEPTH_COLOR is injected by ShaderVariants
+#ifdef DEPTH_COLOR
+    vec3 finalColor = getDepthColor(Depth);
+#else
+    vec3 finalColor = objectColor;
+#endif
     
     // Ensure we have a normalized normal
     vec3 norm = normalize(Normal);
     vec3 result = vec3(0.0);
     
-    for(int i = 0; i < NR_LIGHTS; i++) {
-        if (!lights[i].enabled)
-            continue;
-            
+    // Find this fragment's froxel from its screen tile and view depth
+    ivec3 cell = ivec3(vec3(gl_FragCoord.xy / clusterScale.xy * vec2(clusterDims.xy),
+                            log(max(Depth, 1e-4)) * clusterScale.z + clusterScale.w));
+    cell = clamp(cell, ivec3(0), ivec3(clusterDims.xyz) - 1);
+    int cluster = cell.x + int(clusterDims.x) * (cell.y + int(clusterDims.y) * cell.z);
+    uvec2 range = texelFetch(clusterGrid, cluster).xy;
+
+    vec3 viewDir = normalize(viewPos - FragPos);
+    for (uint j = 0u; j < range.y; j++) {
+        int base = 4 * int(texelFetch(clusterLights, int(range.x + j)).x);
+        vec4 positionRadius = texelFetch(lightData, base);
+
+        // Smooth falloff to zero at the light radius
+        vec3 toLight = positionRadius.xyz - FragPos;
+        float distanceRatio = length(toLight) / positionRadius.w;
+        float window = clamp(1.0 - distanceRatio * distanceRatio * distanceRatio * distanceRatio, 0.0, 1.0);
+        float attenuation = window * window;
+
         // Ambient
-        vec3 ambient = lights[i].ambient * finalColor;
+        vec3 ambient = texelFetch(lightData, base + 1).rgb * finalColor;
         
         // Diffuse
-        vec3 lightDir = normalize(lights[i].position - FragPos);
+        vec3 lightDir = normalize(toLight);
         float diff = max(dot(norm, lightDir), 0.0);
-        vec3 diffuse = lights[i].diffuse * diff * finalColor;
+        vec3 diffuse = texelFetch(lightData, base + 2).rgb * diff * finalColor;
         
         // Specular (Blinn-Phong)
-        vec3 viewDir = normalize(viewPos - FragPos);
         vec3 halfwayDir = normalize(lightDir + viewDir);
         float spec = pow(max(dot(norm, halfwayDir), 0.0), shininess);
-        vec3 specular = lights[i].specular * spec;
+        vec3 specular = texelFetch(lightData, base + 3).rgb * spec;
         
-        result += ambient + diffuse + specular;
+        result += (ambient + diffuse + specular) * attenuation;
     }
     
     FragColor = vec4(result, 1.0);
@@ -1,29 +1,96 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec3 aFaceCenter;
+layout (location = 2) in vec3 aExplodeDir;
+layout (location = 3) in int aPartId;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform float explodeFactor;
+#ifdef INSTANCED
+// Instance stream, see instancing.h; placed before the model matrix applies
+layout (location = 4) in mat4 aInstanceModel;  // Locations 4-7
+layout (location = 8) in mat3 aInstanceNormal; // Locations 8-10, its inverse transpose
+#endif
+
+layout (std140) uniform FrameBlock {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float minDepth;
+    float maxDepth;
+};
+
+layout (std140) uniform ObjectBlock {
+    mat4 model;
+    mat3 normalMatrix; // Inverse transpose of the model matrix, computed on the CPU
+};
+
+// Explode path, injected by ShaderVariants: -1 at rest, 0 along aExplodeDir,
+// 1 baked part keyframes, 2 simulated parts
+#ifndef EXPLODE_MODE
+#define EXPLODE_MODE -1
+#endif
+
+#if EXPLODE_MODE == 0
+uniform float explodeDistance;
+#elif EXPLODE_MODE > 0
+uniform samplerBuffer explodeKeyframes;
+#if EXPLODE_MODE == 1
+uniform float explodeTime;    // Normalized time of the baked animation
+#else
+uniform samplerBuffer fragmentTransforms; // Simulated translation.xyz and angle per part
+#endif
+
+// Must match ExplosionAnimation::KEYFRAMES
+const int KEYFRAMES = 8;
+#endif
 
 out vec3 FragPos;
 out vec3 Normal;
 out float Depth;
 
+// Rodrigues rotation of v about a unit axis
+vec3 rotateAxisAngle(vec3 v, vec3 axis, float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    return v * c + cross(axis, v) * s + axis * dot(axis, v) * (1.0 - c);
+}
+
 void main() {
-    // Apply explode effect
-    vec3 direction = aPos - aFaceCenter;
-    vec3 explodedPos = aPos + direction * explodeFactor;
-    
+    vec3 explodedPos = aPos;
+    vec3 normal = aNormal;
+
+#if EXPLODE_MODE > 0
+    // Move the part rigidly about the pivot and axis stored in its keyframe header
+    int base = aPartId * (KEYFRAMES + 2);
+    vec3 pivot = texelFetch(explodeKeyframes, base).xyz;
+    vec3 axis = texelFetch(explodeKeyframes, base + 1).xyz;
+#if EXPLODE_MODE == 1
+    // Interpolate the two keyframes around the current time
+    float t = clamp(explodeTime, 0.0, 1.0) * float(KEYFRAMES - 1);
+    int k = min(int(t), KEYFRAMES - 2);
+    vec4 key = mix(texelFetch(explodeKeyframes, base + 2 + k),
+                   texelFetch(explodeKeyframes, base + 3 + k), t - float(k));
+#else
+    vec4 key = texelFetch(fragmentTransforms, aPartId);
+#endif
+    explodedPos = pivot + rotateAxisAngle(aPos - pivot, axis, key.w) + key.xyz;
+    normal = rotateAxisAngle(aNormal, axis, key.w);
+#elif EXPLODE_MODE == 0
+    // Apply explode effect along the precomputed per-face or per-part direction
+    explodedPos = aPos + aExplodeDir * explodeDistance;
+#endif
+
+#ifdef INSTANCED
+    // Copies explode in their own frame, then move into place
+    explodedPos = vec3(aInstanceModel * vec4(explodedPos, 1.0));
+    normal = aInstanceNormal * normal;
+#endif
+
     FragPos = vec3(model * vec4(explodedPos, 1.0));
-    
-    // Normal matrix calculation - correctly transforms normals
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    
+
+    Normal = normalMatrix * normal;
+
     gl_Position = projection * view * vec4(FragPos, 1.0);
-    
+
     // Calculate depth for coloring
     vec4 viewPosition = view * vec4(FragPos, 1.0);
     Depth = -viewPosition.z; // Negate because view space z is negative toward the screen
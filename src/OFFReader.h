@@ -36,6 +36,36 @@ typedef struct offmodel {
     float extent;           // Maximum extent of the model
 } OffModel;
 
+/**
+ * Recomputes the bounding box and extent from the vertex positions.
+ * @param model Pointer to the OffModel
+ */
+void computeBoundingBox(OffModel* model) {
+    if (!model) return;
+
+    model->minX = model->minY = model->minZ = FLT_MAX;
+    model->maxX = model->maxY = model->maxZ = -FLT_MAX;
+    for (int i = 0; i < model->numberOfVertices; i++) {
+        float x = model->vertices[i].x;
+        float y = model->vertices[i].y;
+        float z = model->vertices[i].z;
+        if (x < model->minX) model->minX = x;
+        if (x > model->maxX) model->maxX = x;
+        if (y < model->minY) model->minY = y;
+        if (y > model->maxY) model->maxY = y;
+        if (z < model->minZ) model->minZ = z;
+        if (z > model->maxZ) model->maxZ = z;
+    }
+
+    float extentX = model->maxX - model->minX;
+    float extentY = model->maxY - model->minY;
+    float extentZ = model->maxZ - model->minZ;
+    model->extent = extentX;
+    if (extentY > model->extent) model->extent = extentY;
+    if (extentZ > model->extent) model->extent = extentZ;
+    if (model->extent <= 0.0f) model->extent = 1.0f;
+}
+
 /**
  * Reads an OFF file and constructs an OffModel.
  * @param OffFile Path to the OFF file
@@ -101,10 +131,6 @@ OffModel* readOffFile(char* OffFile) {
     model->numberOfVertices = nv;
     model->numberOfPolygons = np;
 
-    // Initialize bounding box
-    model->minX = model->minY = model->minZ = FLT_MAX;
-    model->maxX = model->maxY = model->maxZ = -FLT_MAX;
-
     // Allocate vertices array
     model->vertices = (Vertex*)malloc(nv * sizeof(Vertex));
     if (!model->vertices) {
@@ -138,14 +164,6 @@ OffModel* readOffFile(char* OffFile) {
                 model->vertices[i].normal.x = 0.0f;
                 model->vertices[i].normal.y = 0.0f;
                 model->vertices[i].normal.z = 0.0f;
-
-                // Update bounding box
-                if (x < model->minX) model->minX = x;
-                if (x > model->maxX) model->maxX = x;
-                if (y < model->minY) model->minY = y;
-                if (y > model->maxY) model->maxY = y;
-                if (z < model->minZ) model->minZ = z;
-                if (z > model->maxZ) model->maxZ = z;
                 break;
             }
         }
@@ -238,14 +256,8 @@ OffModel* readOffFile(char* OffFile) {
         }
     }
 
-    // Calculate model extent
-    float extentX = model->maxX - model->minX;
-    float extentY = model->maxY - model->minY;
-    float extentZ = model->maxZ - model->minZ;
-    model->extent = extentX;
-    if (extentY > model->extent) model->extent = extentY;
-    if (extentZ > model->extent) model->extent = extentZ;
-    if (model->extent <= 0.0f) model->extent = 1.0f;
+    // Same bounds as a model restored from the mesh cache
+    computeBoundingBox(model);
 
     fclose(input);
     return model;
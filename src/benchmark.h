@@ -0,0 +1,216 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "../glad/glad.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "render_stats.h"
+
+// Frame timing for --benchmark. The render loop brackets every frame with beginFrame and
+// endFrame; warm-up frames are rendered but not recorded. GPU time comes from
+// GL_TIME_ELAPSED queries kept in a small ring, so a result is read back a few frames
+// after it was issued instead of stalling the frame that issued it.
+class FrameBenchmark {
+public:
+    static constexpr int QUERY_RING = 4;
+
+    FrameBenchmark() = default;
+    FrameBenchmark(const FrameBenchmark&) = delete;
+    FrameBenchmark& operator=(const FrameBenchmark&) = delete;
+
+    ~FrameBenchmark() {
+        if (queries[0]) glDeleteQueries(QUERY_RING, queries);
+    }
+
+    /**
+     * Allocates the timer queries. Needs a current context.
+     * @param frames Frames to record
+     * @param warmupFrames Frames rendered first and discarded (shader and driver warm-up)
+     */
+    void create(int frames, int warmupFrames) {
+        this->frames = frames;
+        this->warmupFrames = warmupFrames;
+        cpuMs.reserve(frames);
+        gpuMs.assign(frames, -1.0);
+        triangles.reserve(frames);
+        drawCalls.reserve(frames);
+        glGenQueries(QUERY_RING, queries);
+        for (int i = 0; i < QUERY_RING; i++) queryFrame[i] = -1;
+    }
+
+    // Frame index on the timeline, warm-up frames included
+    int frame() const { return frameIndex; }
+    int totalFrames() const { return warmupFrames + frames; }
+    bool done() const { return frameIndex >= totalFrames(); }
+
+    void beginFrame() {
+        renderStats.reset();
+        frameStart = std::chrono::high_resolution_clock::now();
+        if (frameIndex < warmupFrames) return;
+
+        // Reusing the oldest slot collects its result first; after QUERY_RING frames it
+        // is normally available without waiting
+        int slot = recorded() % QUERY_RING;
+        collect(slot);
+        glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+        queryFrame[slot] = recorded();
+        queryIssued[slot] = frameStart;
+    }
+
+    // Call after the last draw of the frame, before the swap
+    void endFrame() {
+        if (frameIndex >= warmupFrames) {
+            glEndQuery(GL_TIME_ELAPSED);
+            cpuMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count());
+            triangles.push_back(renderStats.triangles);
+            drawCalls.push_back(renderStats.drawCalls);
+            if (recorded() == 1) runStart = frameStart;
+        }
+        frameIndex++;
+        if (done()) {
+            runEnd = std::chrono::high_resolution_clock::now();
+            for (int slot = 0; slot < QUERY_RING; slot++) collect(slot);
+        }
+    }
+
+    /**
+     * Writes the summary as JSON.
+     * @param meshName Reported as "mesh"
+     * @param mode "windowed" or "headless"
+     * @return true if the file was written
+     */
+    bool writeJSON(const std::string& path, const std::string& meshName, const std::string& mode,
+                   int width, int height) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) return false;
+        const char* renderer = (const char*)glGetString(GL_RENDERER);
+        const char* version = (const char*)glGetString(GL_VERSION);
+        std::vector<double> gpu = gpuSamples();
+
+        fprintf(file, "{\n");
+        fprintf(file, "  \"mesh\": \"%s\",\n", escape(meshName).c_str());
+        fprintf(file, "  \"mode\": \"%s\",\n", mode.c_str());
+        fprintf(file, "  \"renderer\": \"%s\",\n", escape(renderer ? renderer : "").c_str());
+        fprintf(file, "  \"gl_version\": \"%s\",\n", escape(version ? version : "").c_str());
+        fprintf(file, "  \"resolution\": [%d, %d],\n", width, height);
+        fprintf(file, "  \"frames\": %d,\n", recorded());
+        fprintf(file, "  \"warmup_frames\": %d,\n", warmupFrames);
+        fprintf(file, "  \"wall_seconds\": %.6f,\n", wallSeconds());
+        fprintf(file, "  \"cpu_frame_ms\": %s,\n", statsJSON(cpuMs).c_str());
+        fprintf(file, "  \"gpu_frame_ms\": %s,\n", statsJSON(gpu).c_str());
+        fprintf(file, "  \"gpu_samples\": %zu,\n", gpu.size());
+        fprintf(file, "  \"triangles_per_frame\": %.1f,\n", mean(triangles));
+        fprintf(file, "  \"draw_calls_per_frame\": %.2f,\n", mean(drawCalls));
+        fprintf(file, "  \"triangles_per_second\": %.0f,\n", trianglesPerSecond());
+        fprintf(file, "  \"frames_per_second\": %.2f\n", wallSeconds() > 0.0 ? recorded() / wallSeconds() : 0.0);
+        fprintf(file, "}\n");
+        return fclose(file) == 0;
+    }
+
+    void printSummary() const {
+        std::vector<double> cpu = cpuMs;
+        std::vector<double> gpu = gpuSamples();
+        std::cout << "Benchmark: " << recorded() << " frames in " << wallSeconds() << " s" << std::endl;
+        std::cout << "  CPU ms p50/p95/p99: " << percentile(cpu, 50) << " / " << percentile(cpu, 95)
+                  << " / " << percentile(cpu, 99) << std::endl;
+        if (gpu.empty()) {
+            std::cout << "  GPU ms: no timer results" << std::endl;
+        } else {
+            std::cout << "  GPU ms p50/p95/p99: " << percentile(gpu, 50) << " / " << percentile(gpu, 95)
+                      << " / " << percentile(gpu, 99) << std::endl;
+        }
+        std::cout << "  Triangles/s: " << trianglesPerSecond() << ", draw calls/frame: " << mean(drawCalls) << std::endl;
+    }
+
+private:
+    int frames = 0;
+    int warmupFrames = 0;
+    int frameIndex = 0;
+    unsigned int queries[QUERY_RING] = {0};
+    int queryFrame[QUERY_RING];
+    std::chrono::high_resolution_clock::time_point queryIssued[QUERY_RING];
+    std::chrono::high_resolution_clock::time_point frameStart, runStart, runEnd;
+    std::vector<double> cpuMs;
+    std::vector<double> gpuMs; // -1 until the frame's query result is read
+    std::vector<long long> triangles;
+    std::vector<long long> drawCalls;
+
+    int recorded() const { return (int)cpuMs.size(); }
+
+    // Reads the result of a slot's query into its frame, waiting if it is still in flight.
+    // Some drivers (seen on llvmpipe) return garbage for the first query of a context; a
+    // result longer than the wall time since the query was issued is dropped.
+    void collect(int slot) {
+        if (queryFrame[slot] < 0) return;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+        double ms = elapsed / 1.0e6;
+        double sinceIssued = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - queryIssued[slot]).count();
+        if (ms <= sinceIssued) gpuMs[queryFrame[slot]] = ms;
+        queryFrame[slot] = -1;
+    }
+
+    std::vector<double> gpuSamples() const {
+        std::vector<double> samples;
+        for (double ms : gpuMs) {
+            if (ms >= 0.0) samples.push_back(ms);
+        }
+        return samples;
+    }
+
+    double wallSeconds() const {
+        if (recorded() == 0) return 0.0;
+        return std::chrono::duration<double>(runEnd - runStart).count();
+    }
+
+    // Triangles over the time the GPU spent on them; wall time when no timer results exist
+    double trianglesPerSecond() const {
+        double total = 0.0;
+        for (long long t : triangles) total += t;
+        double seconds = 0.0;
+        for (double ms : gpuSamples()) seconds += ms / 1000.0;
+        if (seconds <= 0.0) seconds = wallSeconds();
+        return seconds > 0.0 ? total / seconds : 0.0;
+    }
+
+    template <typename T>
+    static double mean(const std::vector<T>& values) {
+        if (values.empty()) return 0.0;
+        double sum = 0.0;
+        for (T v : values) sum += v;
+        return sum / values.size();
+    }
+
+    // Nearest-rank percentile
+    static double percentile(std::vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        size_t rank = (size_t)std::ceil(p / 100.0 * values.size());
+        return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+    static std::string statsJSON(const std::vector<double>& values) {
+        char text[256];
+        double maxValue = values.empty() ? 0.0 : *std::max_element(values.begin(), values.end());
+        snprintf(text, sizeof(text), "{\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+                 mean(values), percentile(values, 50), percentile(values, 95), percentile(values, 99), maxValue);
+        return text;
+    }
+
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            if ((unsigned char)c >= 0x20) escaped += c;
+        }
+        return escaped;
+    }
+};
+
+#endif // BENCHMARK_H
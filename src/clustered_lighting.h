@@ -0,0 +1,274 @@
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include "../glad/glad.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "parallel.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Light structure
+struct Light {
+    glm::vec3 position;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+    bool enabled;
+    float radius; // Range of the light; it contributes nothing beyond this distance
+
+    Light(glm::vec3 position, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, bool enabled,
+          float radius = 100.0f)
+        : position(position), ambient(ambient), diffuse(diffuse), specular(specular), enabled(enabled), radius(radius) {}
+};
+
+// Texture units of the clustered lighting buffers
+const int LIGHT_DATA_TEXTURE_UNIT = 2;
+const int CLUSTER_GRID_TEXTURE_UNIT = 3;
+const int CLUSTER_LIGHTS_TEXTURE_UNIT = 4;
+
+// Clustered forward lighting. The view frustum is split into a grid of froxels (screen
+// tiles times exponential depth slices) and every frame the CPU lists the lights whose
+// sphere touches each froxel. The fragment shader only loops over the lights of its own
+// froxel, so shading cost follows the local light count rather than the total.
+//
+// Three texture buffers feed the fragment shader:
+//   lightData      RGBA32F, 4 texels per enabled light: position + radius, ambient,
+//                  diffuse, specular
+//   clusterGrid    RG32UI, (first index, count) per froxel
+//   clusterLights  R32UI, light indices of all froxels back to back
+class ClusteredLighting {
+public:
+    static constexpr int GRID_X = 16;
+    static constexpr int GRID_Y = 9;
+    static constexpr int GRID_Z = 24;
+    static constexpr int NUM_CLUSTERS = GRID_X * GRID_Y * GRID_Z;
+    static constexpr int MAX_LIGHTS_PER_CLUSTER = 128; // Extra lights in a froxel are dropped
+
+    // Statistics of the last assignment
+    float assignMs = 0.0f;
+    int maxClusterLights = 0;
+    size_t totalClusterLights = 0;
+    int droppedLights = 0;
+
+    ~ClusteredLighting() {
+        unsigned int buffers[] = {lightBuffer, gridBuffer, indexBuffer};
+        unsigned int textures[] = {lightTexture, gridTexture, indexTexture};
+        glDeleteBuffers(3, buffers);
+        glDeleteTextures(3, textures);
+    }
+
+    // Creates the texture buffers; the grid and index buffers get their final size
+    void create() {
+        createTextureBuffer(lightBuffer, lightTexture, GL_RGBA32F, 0);
+        createTextureBuffer(gridBuffer, gridTexture, GL_RG32UI, NUM_CLUSTERS * 2 * sizeof(uint32_t));
+        createTextureBuffer(indexBuffer, indexTexture, GL_R32UI, NUM_CLUSTERS * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t));
+        scratch.resize((size_t)NUM_CLUSTERS * MAX_LIGHTS_PER_CLUSTER);
+        clusterCounts.resize(NUM_CLUSTERS);
+        gridTexels.resize(NUM_CLUSTERS * 2);
+    }
+
+    // Packs the enabled lights and uploads them. Call after any light edit.
+    void setLights(const std::vector<Light>& lights) {
+        std::vector<glm::vec4> texels;
+        worldPositions.clear();
+        radii.clear();
+        for (const Light& light : lights) {
+            if (!light.enabled) continue;
+            texels.push_back(glm::vec4(light.position, light.radius));
+            texels.push_back(glm::vec4(light.ambient, 0.0f));
+            texels.push_back(glm::vec4(light.diffuse, 0.0f));
+            texels.push_back(glm::vec4(light.specular, 0.0f));
+            worldPositions.push_back(light.position);
+            radii.push_back(light.radius);
+        }
+
+        glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4), texels.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        // Four-wide SoA view-space copies, padded with lights that touch nothing
+        size_t padded = (radii.size() + 3) & ~(size_t)3;
+        viewX.assign(padded, 1e18f);
+        viewY.assign(padded, 1e18f);
+        viewZ.assign(padded, 1e18f);
+        viewRadius.assign(padded, 0.0f);
+        std::copy(radii.begin(), radii.end(), viewRadius.begin());
+    }
+
+    // Recomputes the view-space bounds of every froxel. Call when the projection changes.
+    void setProjection(const glm::mat4& projection, float nearPlane, float farPlane) {
+        float logRatio = std::log(farPlane / nearPlane);
+        sliceScale = GRID_Z / logRatio;
+        sliceBias = -GRID_Z * std::log(nearPlane) / logRatio;
+
+        for (std::vector<float>& bound : bounds) bound.resize(NUM_CLUSTERS);
+        for (int z = 0; z < GRID_Z; z++) {
+            float depthNear = nearPlane * std::pow(farPlane / nearPlane, (float)z / GRID_Z);
+            float depthFar = nearPlane * std::pow(farPlane / nearPlane, (float)(z + 1) / GRID_Z);
+            for (int y = 0; y < GRID_Y; y++) {
+                float ndcY0 = -1.0f + 2.0f * y / GRID_Y, ndcY1 = -1.0f + 2.0f * (y + 1) / GRID_Y;
+                for (int x = 0; x < GRID_X; x++) {
+                    float ndcX0 = -1.0f + 2.0f * x / GRID_X, ndcX1 = -1.0f + 2.0f * (x + 1) / GRID_X;
+                    int c = clusterIndex(x, y, z);
+
+                    // A view-space point at depth d maps to ndc = P[0][0] * x / d
+                    bounds[0][c] = std::min(ndcX0 * depthNear, ndcX0 * depthFar) / projection[0][0];
+                    bounds[1][c] = std::max(ndcX1 * depthNear, ndcX1 * depthFar) / projection[0][0];
+                    bounds[2][c] = std::min(ndcY0 * depthNear, ndcY0 * depthFar) / projection[1][1];
+                    bounds[3][c] = std::max(ndcY1 * depthNear, ndcY1 * depthFar) / projection[1][1];
+                    bounds[4][c] = -depthFar;
+                    bounds[5][c] = -depthNear;
+                }
+            }
+        }
+    }
+
+    // Assigns lights to froxels for the given view and uploads the grid and index list.
+    // Call when the view, the projection or the lights change.
+    void assign(const glm::mat4& view) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (size_t i = 0; i < worldPositions.size(); i++) {
+            glm::vec3 p = glm::vec3(view * glm::vec4(worldPositions[i], 1.0f));
+            viewX[i] = p.x;
+            viewY[i] = p.y;
+            viewZ[i] = p.z;
+        }
+
+        parallelFor(0, NUM_CLUSTERS, [&](int begin, int end) {
+            for (int c = begin; c < end; c++) {
+                clusterCounts[c] = cullCluster(c, &scratch[(size_t)c * MAX_LIGHTS_PER_CLUSTER]);
+            }
+        }, 256);
+
+        // Compact the per-froxel lists into one index list
+        uint32_t offset = 0;
+        maxClusterLights = 0;
+        droppedLights = 0;
+        for (int c = 0; c < NUM_CLUSTERS; c++) {
+            int count = clusterCounts[c];
+            droppedLights += std::max(count - MAX_LIGHTS_PER_CLUSTER, 0);
+            count = std::min(count, MAX_LIGHTS_PER_CLUSTER);
+            gridTexels[2 * c] = offset;
+            gridTexels[2 * c + 1] = count;
+            maxClusterLights = std::max(maxClusterLights, count);
+            offset += count;
+        }
+        totalClusterLights = offset;
+        indices.resize(offset);
+        parallelFor(0, NUM_CLUSTERS, [&](int begin, int end) {
+            for (int c = begin; c < end; c++) {
+                std::copy_n(scratch.data() + (size_t)c * MAX_LIGHTS_PER_CLUSTER, gridTexels[2 * c + 1], indices.data() + gridTexels[2 * c]);
+            }
+        }, 1024);
+
+        glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, gridTexels.size() * sizeof(uint32_t), gridTexels.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, indices.size() * sizeof(uint32_t), indices.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        auto finish = std::chrono::high_resolution_clock::now();
+        assignMs = std::chrono::duration<float, std::milli>(finish - start).count();
+    }
+
+    // Binds the three texture buffers to their units
+    void bind() const {
+        glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_LIGHTS_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    int lightCount() const { return (int)radii.size(); }
+
+    // Depth slice of a view-space depth d is floor(log(d) * sliceScale + sliceBias)
+    float getSliceScale() const { return sliceScale; }
+    float getSliceBias() const { return sliceBias; }
+
+private:
+    unsigned int lightBuffer = 0, lightTexture = 0;
+    unsigned int gridBuffer = 0, gridTexture = 0;
+    unsigned int indexBuffer = 0, indexTexture = 0;
+
+    float sliceScale = 0.0f, sliceBias = 0.0f;
+    std::vector<float> bounds[6]; // Froxel AABBs in view space: min x, max x, min y, max y, min z, max z
+
+    std::vector<glm::vec3> worldPositions;
+    std::vector<float> radii;
+    std::vector<float> viewX, viewY, viewZ, viewRadius; // SoA, padded to a multiple of 4
+
+    std::vector<uint32_t> scratch;      // MAX_LIGHTS_PER_CLUSTER slots per froxel
+    std::vector<int> clusterCounts;     // Lights touching each froxel, before clamping
+    std::vector<uint32_t> gridTexels;   // (first index, count) per froxel
+    std::vector<uint32_t> indices;      // Compacted light indices
+
+    static int clusterIndex(int x, int y, int z) { return x + GRID_X * (y + GRID_Y * z); }
+
+    static void createTextureBuffer(unsigned int& buffer, unsigned int& texture, GLenum format, size_t bytes) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Writes the lights whose sphere touches froxel c (up to MAX_LIGHTS_PER_CLUSTER) and
+    // returns how many touch it. Tests four lights at a time against the froxel AABB.
+    int cullCluster(int c, uint32_t* out) const {
+        int count = 0;
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128 minX = _mm_set1_ps(bounds[0][c]), maxX = _mm_set1_ps(bounds[1][c]);
+        const __m128 minY = _mm_set1_ps(bounds[2][c]), maxY = _mm_set1_ps(bounds[3][c]);
+        const __m128 minZ = _mm_set1_ps(bounds[4][c]), maxZ = _mm_set1_ps(bounds[5][c]);
+        const __m128 zero = _mm_setzero_ps();
+        for (; i < viewRadius.size(); i += 4) {
+            __m128 x = _mm_loadu_ps(&viewX[i]);
+            __m128 y = _mm_loadu_ps(&viewY[i]);
+            __m128 z = _mm_loadu_ps(&viewZ[i]);
+            __m128 r = _mm_loadu_ps(&viewRadius[i]);
+
+            // Distance from each center to the box, per axis
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+            __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+            int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, _mm_mul_ps(r, r)));
+            while (mask) {
+                int lane = __builtin_ctz(mask);
+                if (count < MAX_LIGHTS_PER_CLUSTER) out[count] = (uint32_t)(i + lane);
+                count++;
+                mask &= mask - 1;
+            }
+        }
+#endif
+        for (; i < viewRadius.size(); i++) {
+            float dx = std::max(std::max(bounds[0][c] - viewX[i], viewX[i] - bounds[1][c]), 0.0f);
+            float dy = std::max(std::max(bounds[2][c] - viewY[i], viewY[i] - bounds[3][c]), 0.0f);
+            float dz = std::max(std::max(bounds[4][c] - viewZ[i], viewZ[i] - bounds[5][c]), 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= viewRadius[i] * viewRadius[i]) {
+                if (count < MAX_LIGHTS_PER_CLUSTER) out[count] = (uint32_t)i;
+                count++;
+            }
+        }
+        return count;
+    }
+};
+
+#endif // CLUSTERED_LIGHTING_H
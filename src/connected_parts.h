@@ -0,0 +1,102 @@
+#ifndef CONNECTED_PARTS_H
+#define CONNECTED_PARTS_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "OFFReader.h"
+#include "parallel.h"
+#include "profiler.h"
+
+// Lock-free union-find over vertex indices. Roots are always linked towards the smaller
+// index, so concurrent unions cannot form cycles; finds compress paths by halving.
+class ConcurrentUnionFind {
+public:
+    explicit ConcurrentUnionFind(int count) : parent(new std::atomic<int>[count]) {
+        parallelFor(0, count, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                parent[i].store(i, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    int find(int x) {
+        for (;;) {
+            int p = parent[x].load(std::memory_order_relaxed);
+            if (p == x) return x;
+            int grandparent = parent[p].load(std::memory_order_relaxed);
+            if (grandparent != p) {
+                parent[x].compare_exchange_weak(p, grandparent, std::memory_order_relaxed);
+            }
+            x = grandparent;
+        }
+    }
+
+    void unite(int a, int b) {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return;
+            if (a < b) std::swap(a, b);
+
+            // Link the larger root under the smaller one if it is still a root
+            int expected = a;
+            if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) return;
+        }
+    }
+
+private:
+    std::unique_ptr<std::atomic<int>[]> parent;
+};
+
+// Connected components of the face graph of an OffModel
+struct ConnectedParts {
+    std::vector<int> vertexPart; // Part of each vertex, -1 for vertices used by no face
+    int numParts = 0;
+
+    /**
+     * Labels parts with a parallel union-find over polygon edges. Part ids follow the
+     * order in which parts first appear in the vertex array.
+     * @param model Pointer to the OffModel
+     */
+    void build(const OffModel* model) {
+        PROFILE_ZONE("Find connected parts");
+        vertexPart.clear();
+        numParts = 0;
+        if (!model) return;
+
+        int nv = model->numberOfVertices;
+        ConcurrentUnionFind sets(nv);
+        // Written by several threads at once for shared vertices, so atomic
+        std::unique_ptr<std::atomic<unsigned char>[]> used(new std::atomic<unsigned char>[nv]);
+        for (int v = 0; v < nv; v++) used[v].store(0, std::memory_order_relaxed);
+
+        parallelFor(0, model->numberOfPolygons, [&](int begin, int end) {
+            for (int f = begin; f < end; f++) {
+                const Polygon& polygon = model->polygons[f];
+                for (int j = 0; j < polygon.noSides; j++) {
+                    used[polygon.v[j]].store(1, std::memory_order_relaxed);
+                    if (j > 0) sets.unite(polygon.v[0], polygon.v[j]);
+                }
+            }
+        });
+
+        std::vector<int> root(nv);
+        parallelFor(0, nv, [&](int begin, int end) {
+            for (int v = begin; v < end; v++) {
+                root[v] = sets.find(v);
+            }
+        });
+
+        // Compact root indices into dense part ids
+        std::vector<int> rootPart(nv, -1);
+        vertexPart.assign(nv, -1);
+        for (int v = 0; v < nv; v++) {
+            if (!used[v].load(std::memory_order_relaxed)) continue;
+            if (rootPart[root[v]] < 0) rootPart[root[v]] = numParts++;
+            vertexPart[v] = rootPart[root[v]];
+        }
+    }
+};
+
+#endif // CONNECTED_PARTS_H
@@ -0,0 +1,115 @@
+#ifndef EXPLOSION_ANIMATION_H
+#define EXPLOSION_ANIMATION_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "parallel.h"
+#include "profiler.h"
+
+// Deterministic value in [0, 1) for a part and a channel, so explode effects vary per part
+// but look the same on every run
+float partRandom(int part, uint32_t channel) {
+    uint32_t h = (uint32_t)part * 0x9E3779B1u ^ channel * 0x85EBCA77u;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+// Rodrigues rotation of v about a unit axis, as rotateAxisAngle in vertex_shader.glsl
+glm::vec3 rotateAxisAngle(const glm::vec3& v, const glm::vec3& axis, float angle) {
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    return v * c + glm::cross(axis, v) * s + axis * glm::dot(axis, v) * (1.0f - c);
+}
+
+// Per-part explode trajectories baked once at load into a float RGBA texture buffer.
+// The vertex shader samples it with the animation time, so playing the animation costs
+// no CPU work regardless of the number of parts.
+//
+// Texel layout, (2 + KEYFRAMES) texels per part:
+//   base + 0:             pivot.xyz (part center), unused
+//   base + 1:             rotation axis.xyz, unused
+//   base + 2 + k:         translation.xyz, rotation angle at time k / (KEYFRAMES - 1)
+// KEYFRAMES must match the constant in vertex_shader.glsl.
+struct ExplosionAnimation {
+    static constexpr int KEYFRAMES = 8;
+    static constexpr int TEXELS_PER_PART = 2 + KEYFRAMES;
+
+    // Shape of the baked motion
+    float stagger = 0.35f;      // Fraction of the timeline over which part departures are spread
+    float spread = 1.0f;        // Travel distance in bounding sphere radii
+    float arc = 0.25f;          // Peak lift along +Y in bounding sphere radii
+    float maxSpin = 3.14159265f; // Largest rotation in radians over the animation
+
+    std::vector<glm::vec4> texels;
+    int numParts = 0;
+
+    /**
+     * Bakes keyframes for every part. Outer parts leave first, each part eases out along
+     * its direction on a lifted arc while spinning about a fixed random axis.
+     * @param centers Center of each part, used as the rotation pivot
+     * @param directions Unit explode direction of each part
+     * @param meshCenter Center the directions radiate from
+     * @param radius Bounding sphere radius of the mesh
+     */
+    void bake(const std::vector<glm::vec3>& centers, const std::vector<glm::vec3>& directions,
+              const glm::vec3& meshCenter, float radius) {
+        PROFILE_ZONE("Bake explosion keyframes");
+        numParts = (int)centers.size();
+        texels.assign((size_t)numParts * TEXELS_PER_PART, glm::vec4(0.0f));
+
+        float maxDistance = 0.0f;
+        for (const glm::vec3& center : centers) {
+            maxDistance = std::max(maxDistance, glm::length(center - meshCenter));
+        }
+
+        parallelFor(0, numParts, [&](int begin, int end) {
+            for (int p = begin; p < end; p++) {
+                glm::vec4* part = &texels[(size_t)p * TEXELS_PER_PART];
+
+                glm::vec3 axis(partRandom(p, 1) - 0.5f, partRandom(p, 2) - 0.5f, partRandom(p, 3) - 0.5f);
+                float axisLength = glm::length(axis);
+                axis = axisLength > 0.0001f ? axis / axisLength : glm::vec3(0.0f, 1.0f, 0.0f);
+
+                float outer = maxDistance > 0.0f ? glm::length(centers[p] - meshCenter) / maxDistance : 0.0f;
+                float delay = stagger * (1.0f - outer);
+                float distance = radius * spread * (0.6f + 0.8f * partRandom(p, 4));
+                float spin = maxSpin * (2.0f * partRandom(p, 5) - 1.0f);
+
+                part[0] = glm::vec4(centers[p], 0.0f);
+                part[1] = glm::vec4(axis, 0.0f);
+                for (int k = 0; k < KEYFRAMES; k++) {
+                    float time = (float)k / (KEYFRAMES - 1);
+                    float local = glm::clamp((time - delay) / (1.0f - stagger), 0.0f, 1.0f);
+                    float eased = 1.0f - (1.0f - local) * (1.0f - local) * (1.0f - local);
+
+                    glm::vec3 translation = directions[p] * (distance * eased);
+                    translation.y += radius * arc * std::sin(3.14159265f * local);
+                    part[2 + k] = glm::vec4(translation, spin * eased);
+                }
+            }
+        }, 4096);
+    }
+
+    size_t bytes() const { return texels.size() * sizeof(glm::vec4); }
+
+    glm::vec3 pivot(int part) const { return glm::vec3(texels[(size_t)part * TEXELS_PER_PART]); }
+    glm::vec3 axis(int part) const { return glm::vec3(texels[(size_t)part * TEXELS_PER_PART + 1]); }
+
+    // Translation.xyz and angle of a part at a time in [0, 1], interpolated between the
+    // two nearest keyframes the way the vertex shader samples them
+    glm::vec4 key(int part, float time) const {
+        const glm::vec4* keys = &texels[(size_t)part * TEXELS_PER_PART + 2];
+        float t = glm::clamp(time, 0.0f, 1.0f) * (float)(KEYFRAMES - 1);
+        int k = std::min((int)t, KEYFRAMES - 2);
+        return glm::mix(keys[k], keys[k + 1], t - (float)k);
+    }
+};
+
+#endif // EXPLOSION_ANIMATION_H
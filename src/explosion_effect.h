@@ -2,127 +2,225 @@
 #define EXPLOSION_EFFECT_H
 
 #include <glm/glm.hpp>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 #include <algorithm>
-#include <map>
-#include "OFFReader.h"
+#include "parallel.h"
+#include "profiler.h"
 
-// Storage for explosion data for OFF models
-struct ExplodedVertexData {
-    float originalX, originalY, originalZ;
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// The AVX2/FMA kernel is compiled for that target alone and picked at run time, so one
+// binary built for baseline x86-64 still uses it where the CPU has it
+#if defined(__SSE2__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EXPLOSION_AVX2_DISPATCH 1
+#endif
+
+// CPU-side evaluation of the explode effect. Rendering explodes on the GPU from the same
+// precomputed directions; this is only used when exploded geometry is needed on the CPU
+// (export, picking), so nothing here runs per frame.
+
+// Refers to one explosion state; stale handles are detected through the generation
+struct ExplosionHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool valid() const { return index != UINT32_MAX; }
 };
 
-// Map to store original vertex positions for each model
-std::map<OffModel*, std::vector<ExplodedVertexData>> explodedModels;
+// Original positions and unit explode directions of one model in SoA layout.
+// Move-only so a state is never duplicated once registered.
+struct ExplosionState {
+    glm::vec3 centroid = glm::vec3(0.0f); // Point the directions radiate from
+    std::vector<float> originalX, originalY, originalZ;
+    std::vector<float> directionX, directionY, directionZ;
+
+    ExplosionState() = default;
+    ExplosionState(ExplosionState&&) = default;
+    ExplosionState& operator=(ExplosionState&&) = default;
+    ExplosionState(const ExplosionState&) = delete;
+    ExplosionState& operator=(const ExplosionState&) = delete;
 
-// Initialize explosion data for a model
-void initializeExplosion(OffModel* model) {
-    if (!model) return;
-    
-    // Check if model already initialized
-    if (explodedModels.find(model) != explodedModels.end()) {
-        return; // Already initialized
+    void resize(size_t count) {
+        originalX.resize(count); originalY.resize(count); originalZ.resize(count);
+        directionX.resize(count); directionY.resize(count); directionZ.resize(count);
     }
-    
-    // Create storage for original vertex positions
-    std::vector<ExplodedVertexData> originalVertices;
-    originalVertices.resize(model->numberOfVertices);
-    
-    // Store original positions
-    for (int i = 0; i < model->numberOfVertices; i++) {
-        originalVertices[i].originalX = model->vertices[i].x;
-        originalVertices[i].originalY = model->vertices[i].y;
-        originalVertices[i].originalZ = model->vertices[i].z;
+
+    size_t size() const { return originalX.size(); }
+
+    void set(size_t i, const glm::vec3& original, const glm::vec3& direction) {
+        originalX[i] = original.x; originalY[i] = original.y; originalZ[i] = original.z;
+        directionX[i] = direction.x; directionY[i] = direction.y; directionZ[i] = direction.z;
     }
-    
-    // Store data for this model
-    explodedModels[model] = originalVertices;
-}
+};
 
-// Update model vertices for explosion effect
-void updateExplosion(OffModel* model, float factor) {
-    if (!model) return;
-    
-    // Check if model is initialized for explosion
-    if (explodedModels.find(model) == explodedModels.end()) {
-        initializeExplosion(model);
-        return;
+// Exploded positions produced by updateExplosion, in the same SoA layout
+struct ExplodedPositions {
+    std::vector<float> x, y, z;
+
+    void resize(size_t count) { x.resize(count); y.resize(count); z.resize(count); }
+    size_t size() const { return x.size(); }
+};
+
+// Dense store of explosion states addressed by handles. States stay packed in one array
+// (removal swaps the last state into the hole) and every lookup is a pair of array reads.
+class ExplosionRegistry {
+public:
+    ExplosionHandle create(ExplosionState&& state) {
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = (uint32_t)slots.size();
+            slots.push_back(Slot());
+        }
+
+        slots[slot].dense = (uint32_t)states.size();
+        states.push_back(std::move(state));
+        denseToSlot.push_back(slot);
+
+        ExplosionHandle handle;
+        handle.index = slot;
+        handle.generation = slots[slot].generation;
+        return handle;
     }
-    
-    // Get original vertex data
-    const std::vector<ExplodedVertexData>& originalVertices = explodedModels[model];
-    
-    // Calculate center of the model
-    glm::vec3 center(0.0f);
-    for (int i = 0; i < model->numberOfVertices; i++) {
-        center.x += originalVertices[i].originalX;
-        center.y += originalVertices[i].originalY;
-        center.z += originalVertices[i].originalZ;
+
+    // Returns the state for a handle, or nullptr if the handle is stale
+    ExplosionState* get(ExplosionHandle handle) {
+        if (!isAlive(handle)) return nullptr;
+        return &states[slots[handle.index].dense];
     }
-    center /= static_cast<float>(model->numberOfVertices);
-    
-    // Apply explosion effect - move vertices away from center
-    for (int i = 0; i < model->numberOfVertices; i++) {
-        // Get original position
-        float origX = originalVertices[i].originalX;
-        float origY = originalVertices[i].originalY;
-        float origZ = originalVertices[i].originalZ;
-        
-        // Calculate direction from center to vertex
-        glm::vec3 direction(origX - center.x, origY - center.y, origZ - center.z);
-        float distance = glm::length(direction);
-        
-        // Normalize direction (if not too small)
-        if (distance > 0.0001f) {
-            direction = glm::normalize(direction);
-        } else {
-            // Default direction if vertex is at center
-            direction = glm::vec3(0.0f, 1.0f, 0.0f);
+
+    bool isAlive(ExplosionHandle handle) const {
+        return handle.index < slots.size() &&
+               slots[handle.index].generation == handle.generation &&
+               slots[handle.index].dense != UINT32_MAX;
+    }
+
+    void destroy(ExplosionHandle handle) {
+        if (!isAlive(handle)) return;
+
+        uint32_t dense = slots[handle.index].dense;
+        uint32_t last = (uint32_t)states.size() - 1;
+        if (dense != last) {
+            states[dense] = std::move(states[last]);
+            denseToSlot[dense] = denseToSlot[last];
+            slots[denseToSlot[dense]].dense = dense;
         }
-        
-        // Apply explosion effect
-        model->vertices[i].x = origX + direction.x * factor;
-        model->vertices[i].y = origY + direction.y * factor;
-        model->vertices[i].z = origZ + direction.z * factor;
+        states.pop_back();
+        denseToSlot.pop_back();
+
+        slots[handle.index].dense = UINT32_MAX;
+        slots[handle.index].generation++;
+        freeSlots.push_back(handle.index);
     }
-    
-    // Recalculate normals after changing positions
-    computeNormals(model);
-}
 
-// Reset model to original positions
-void resetExplosion(OffModel* model) {
-    if (!model) return;
-    
-    // Check if model is initialized for explosion
-    if (explodedModels.find(model) == explodedModels.end()) {
-        return; // No original data to reset to
+    void clear() {
+        for (uint32_t slot : denseToSlot) {
+            slots[slot].dense = UINT32_MAX;
+            slots[slot].generation++;
+            freeSlots.push_back(slot);
+        }
+        states.clear();
+        denseToSlot.clear();
+    }
+
+    size_t size() const { return states.size(); }
+
+private:
+    struct Slot {
+        uint32_t dense = UINT32_MAX; // Position in states, UINT32_MAX when free
+        uint32_t generation = 0;
+    };
+
+    std::vector<ExplosionState> states;  // Packed live states
+    std::vector<uint32_t> denseToSlot;   // Owning slot of each packed state
+    std::vector<Slot> slots;             // Handle index -> packed position
+    std::vector<uint32_t> freeSlots;
+};
+
+// Registry shared by all exploding models
+ExplosionRegistry explosionRegistry;
+
+#if defined(EXPLOSION_AVX2_DISPATCH)
+// Eight lanes with a fused multiply-add; only called when the CPU supports AVX2 and FMA
+__attribute__((target("avx2,fma")))
+void explodeComponentAVX2(const float* original, const float* direction, float distance,
+                          float* out, size_t begin, size_t end) {
+    size_t i = begin;
+    __m256 d = _mm256_set1_ps(distance);
+    for (; i + 8 <= end; i += 8) {
+        __m256 o = _mm256_loadu_ps(original + i);
+        __m256 v = _mm256_loadu_ps(direction + i);
+        _mm256_storeu_ps(out + i, _mm256_fmadd_ps(v, d, o));
     }
-    
-    // Get original vertex data
-    const std::vector<ExplodedVertexData>& originalVertices = explodedModels[model];
-    
-    // Reset all vertices to original positions
-    for (int i = 0; i < model->numberOfVertices; i++) {
-        model->vertices[i].x = originalVertices[i].originalX;
-        model->vertices[i].y = originalVertices[i].originalY;
-        model->vertices[i].z = originalVertices[i].originalZ;
+    for (; i < end; i++) {
+        out[i] = std::fma(direction[i], distance, original[i]);
     }
-    
-    // Recalculate normals after resetting positions
-    computeNormals(model);
 }
 
-// Clean up explosion data for a model
-void cleanupExplosionData(OffModel* model) {
-    if (explodedModels.find(model) != explodedModels.end()) {
-        explodedModels.erase(model);
+bool cpuHasAVX2FMA() {
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+}
+#endif
+
+// out[i] = original[i] + direction[i] * distance for i in [begin, end): eight lanes with a
+// fused multiply-add on CPUs with AVX2 and FMA, otherwise four (SSE2) or one at a time
+void explodeComponent(const float* original, const float* direction, float distance,
+                      float* out, size_t begin, size_t end) {
+#if defined(EXPLOSION_AVX2_DISPATCH)
+    if (cpuHasAVX2FMA()) {
+        explodeComponentAVX2(original, direction, distance, out, begin, end);
+        return;
+    }
+#endif
+    size_t i = begin;
+#if defined(__SSE2__)
+    __m128 d = _mm_set1_ps(distance);
+    for (; i + 4 <= end; i += 4) {
+        __m128 o = _mm_loadu_ps(original + i);
+        __m128 v = _mm_loadu_ps(direction + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(o, _mm_mul_ps(v, d)));
+    }
+#endif
+    for (; i < end; i++) {
+        out[i] = original[i] + direction[i] * distance;
     }
 }
 
+/**
+ * Evaluates exploded positions: original + direction * distance.
+ * Output arrays must hold state.size() floats; nothing is allocated here. Large states are
+ * split across the thread pool.
+ * @return false if the handle is stale
+ */
+bool updateExplosion(ExplosionHandle handle, float distance, float* outX, float* outY, float* outZ) {
+    PROFILE_ZONE("updateExplosion");
+    ExplosionState* state = explosionRegistry.get(handle);
+    if (!state) return false;
+
+    parallelFor(0, (int)state->size(), [&](int begin, int end) {
+        explodeComponent(state->originalX.data(), state->directionX.data(), distance, outX, begin, end);
+        explodeComponent(state->originalY.data(), state->directionY.data(), distance, outY, begin, end);
+        explodeComponent(state->originalZ.data(), state->directionZ.data(), distance, outZ, begin, end);
+    }, 65536);
+    return true;
+}
+
+// Clean up explosion data for one model
+void cleanupExplosionData(ExplosionHandle& handle) {
+    explosionRegistry.destroy(handle);
+    handle = ExplosionHandle();
+}
+
 // Clean up all explosion data
 void cleanupAllExplosionData() {
-    explodedModels.clear();
+    explosionRegistry.clear();
 }
 
-#endif // EXPLOSION_EFFECT_H
\ No newline at end of file
+#endif // EXPLOSION_EFFECT_H
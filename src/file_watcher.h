@@ -0,0 +1,100 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Reports changes to the files with one extension in a directory. Uses inotify on Linux,
+// watching the directory rather than the files so editors that save by renaming a new
+// file over the old one are seen too. Elsewhere it compares modification times on poll.
+class FileWatcher {
+public:
+    FileWatcher() = default;
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    ~FileWatcher() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    /**
+     * Starts watching a directory.
+     * @param extension Only files ending in this are reported, e.g. ".glsl"
+     * @return false if the directory cannot be watched
+     */
+    bool watch(const std::string& directory, const std::string& extension) {
+        this->directory = directory;
+        this->extension = extension;
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) return false;
+        if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        return true;
+#else
+        lastWriteTime = newestWriteTime();
+        return std::filesystem::is_directory(directory);
+#endif
+    }
+
+    // Whether a watched file changed since the last call; never blocks
+    bool poll() {
+        bool changed = false;
+#ifdef __linux__
+        if (fd < 0) return false;
+        alignas(inotify_event) char buffer[4096];
+        for (;;) {
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length <= 0) break;
+            for (char* p = buffer; p < buffer + length;) {
+                const inotify_event* event = (const inotify_event*)p;
+                if (event->len > 0 && matches(event->name)) changed = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+#else
+        auto time = newestWriteTime();
+        changed = time != lastWriteTime;
+        lastWriteTime = time;
+#endif
+        return changed;
+    }
+
+private:
+    std::string directory;
+    std::string extension;
+#ifdef __linux__
+    int fd = -1;
+#else
+    std::filesystem::file_time_type lastWriteTime;
+
+    std::filesystem::file_time_type newestWriteTime() const {
+        std::filesystem::file_time_type newest{};
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            if (!matches(entry.path().filename().string())) continue;
+            auto time = entry.last_write_time(ec);
+            if (!ec && time > newest) newest = time;
+        }
+        return newest;
+    }
+#endif
+
+    bool matches(const std::string& name) const {
+        return name.size() >= extension.size() &&
+               name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+    }
+};
+
+#endif // FILE_WATCHER_H
@@ -0,0 +1,213 @@
+#ifndef FRAGMENT_SIMULATION_H
+#define FRAGMENT_SIMULATION_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include "parallel.h"
+#include "explosion_animation.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+// Rigid-fragment physics for the explode view. Every connected part is a fragment thrown
+// from its rest pose, falling under gravity, spinning about a fixed axis and bouncing off a
+// ground plane below the mesh. State lives in SoA arrays that are integrated four lanes at
+// a time across the thread pool. The simulation stops by itself once every fragment rests
+// on the ground.
+//
+// Each step writes one texel per fragment, translation.xyz and rotation angle, in the layout
+// the vertex shader reads; the pivot and axis come from the baked keyframe header.
+class FragmentSimulation {
+public:
+    // Tunables, in bounding sphere radii and seconds
+    float gravity = 3.0f;        // Downward acceleration
+    float launchSpeed = 1.5f;    // Mean initial speed along the part direction
+    float launchLift = 1.0f;     // Extra upward speed at launch
+    float maxSpin = 6.0f;        // Largest angular speed in radians per second
+    float restitution = 0.35f;   // Fraction of the vertical speed kept on a bounce
+    float contactDamping = 0.9f; // Horizontal and angular speed kept per 1/60 s on the ground
+    float settleSpeed = 0.05f;   // Speed below which a grounded fragment counts as resting
+    float settleSpin = 0.05f;    // Angular speed in radians per second, likewise
+    float maxStep = 1.0f / 30.0f;
+
+    bool running = false; // Cleared by reset() and once every fragment is at rest
+
+    /**
+     * Sets up the fragments at rest.
+     * @param centers Center of each part
+     * @param radii Bounding radius of each part around its center, used for ground contact
+     * @param groundY Height of the ground plane
+     */
+    void init(const std::vector<glm::vec3>& centers, const std::vector<float>& radii, float groundY) {
+        size_t n = centers.size();
+        restOffsetY.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            // Lowest offset before the part's bounding sphere touches the ground
+            restOffsetY[i] = groundY + radii[i] - centers[i].y;
+        }
+        offsetX.resize(n); offsetY.resize(n); offsetZ.resize(n);
+        velocityX.resize(n); velocityY.resize(n); velocityZ.resize(n);
+        angle.resize(n); spin.resize(n);
+        transforms.resize(n);
+        reset();
+    }
+
+    // Puts every fragment back in its rest pose
+    void reset() {
+        std::fill(offsetX.begin(), offsetX.end(), 0.0f);
+        std::fill(offsetY.begin(), offsetY.end(), 0.0f);
+        std::fill(offsetZ.begin(), offsetZ.end(), 0.0f);
+        std::fill(velocityX.begin(), velocityX.end(), 0.0f);
+        std::fill(velocityY.begin(), velocityY.end(), 0.0f);
+        std::fill(velocityZ.begin(), velocityZ.end(), 0.0f);
+        std::fill(angle.begin(), angle.end(), 0.0f);
+        std::fill(spin.begin(), spin.end(), 0.0f);
+        std::fill(transforms.begin(), transforms.end(), glm::vec4(0.0f));
+        running = false;
+    }
+
+    /**
+     * Resets the fragments and throws them outwards.
+     * @param directions Unit explode direction of each part
+     * @param meshRadius Bounding sphere radius of the mesh, the unit of the tunables
+     */
+    void launch(const std::vector<glm::vec3>& directions, float meshRadius) {
+        reset();
+        scale = meshRadius;
+        for (size_t i = 0; i < directions.size(); i++) {
+            int part = (int)i;
+            float speed = meshRadius * launchSpeed * (0.5f + partRandom(part, 6));
+            velocityX[i] = directions[i].x * speed;
+            velocityY[i] = directions[i].y * speed + meshRadius * launchLift * partRandom(part, 7);
+            velocityZ[i] = directions[i].z * speed;
+            spin[i] = maxSpin * (2.0f * partRandom(part, 5) - 1.0f);
+        }
+        running = true;
+    }
+
+    // Advances the simulation by dt seconds (clamped to maxStep) and refreshes transforms
+    void step(float dt) {
+        if (!running) return;
+        dt = std::min(dt, maxStep);
+        float gravityStep = -gravity * scale * dt;
+        // Damping is a rate, so the same sliding distance results at any frame rate
+        float damping = std::pow(contactDamping, dt * 60.0f);
+
+        std::atomic<bool> moving(false);
+        parallelFor(0, (int)size(), [&](int begin, int end) {
+            if (!integrate(begin, end, dt, gravityStep, damping)) moving.store(true, std::memory_order_relaxed);
+        }, 8192);
+        running = moving.load(std::memory_order_relaxed);
+    }
+
+    size_t size() const { return restOffsetY.size(); }
+
+    // Translation.xyz and angle of every fragment, ready for upload
+    const std::vector<glm::vec4>& getTransforms() const { return transforms; }
+
+private:
+    float scale = 1.0f;
+    std::vector<float> restOffsetY;
+    std::vector<float> offsetX, offsetY, offsetZ;
+    std::vector<float> velocityX, velocityY, velocityZ;
+    std::vector<float> angle, spin;
+    std::vector<glm::vec4> transforms;
+
+    /**
+     * Semi-implicit Euler step with ground contact for fragments [begin, end).
+     * @param damping Speed kept by grounded fragments over this step
+     * @return true if every fragment in the range is resting on the ground
+     */
+    bool integrate(int begin, int end, float dt, float gravityStep, float damping) {
+        float restSpeed2 = settleSpeed * scale * settleSpeed * scale;
+        float restSpin2 = settleSpin * settleSpin;
+        bool resting = true;
+        int i = begin;
+#if defined(__SSE2__)
+        const __m128 vdt = _mm_set1_ps(dt);
+        const __m128 vgravity = _mm_set1_ps(gravityStep);
+        const __m128 vrestitution = _mm_set1_ps(-restitution);
+        const __m128 vdamping = _mm_set1_ps(damping);
+        const __m128 vrestSpeed2 = _mm_set1_ps(restSpeed2);
+        const __m128 vrestSpin2 = _mm_set1_ps(restSpin2);
+        const __m128 zero = _mm_setzero_ps();
+        float* out = &transforms[0].x;
+
+        for (; i + 4 <= end; i += 4) {
+            __m128 vx = _mm_loadu_ps(&velocityX[i]);
+            __m128 vy = _mm_add_ps(_mm_loadu_ps(&velocityY[i]), vgravity);
+            __m128 vz = _mm_loadu_ps(&velocityZ[i]);
+            __m128 w = _mm_loadu_ps(&spin[i]);
+
+            __m128 ox = _mm_add_ps(_mm_loadu_ps(&offsetX[i]), _mm_mul_ps(vx, vdt));
+            __m128 oy = _mm_add_ps(_mm_loadu_ps(&offsetY[i]), _mm_mul_ps(vy, vdt));
+            __m128 oz = _mm_add_ps(_mm_loadu_ps(&offsetZ[i]), _mm_mul_ps(vz, vdt));
+            __m128 a = _mm_add_ps(_mm_loadu_ps(&angle[i]), _mm_mul_ps(w, vdt));
+
+            // Ground contact: clamp to the rest height, bounce if falling, damp sliding and spin
+            __m128 rest = _mm_loadu_ps(&restOffsetY[i]);
+            __m128 contact = _mm_cmplt_ps(oy, rest);
+            __m128 falling = _mm_and_ps(contact, _mm_cmplt_ps(vy, zero));
+            oy = select(contact, rest, oy);
+            vy = select(falling, _mm_mul_ps(vy, vrestitution), vy);
+            vx = select(contact, _mm_mul_ps(vx, vdamping), vx);
+            vz = select(contact, _mm_mul_ps(vz, vdamping), vz);
+            w = select(contact, _mm_mul_ps(w, vdamping), w);
+
+            __m128 speed2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+            __m128 still = _mm_and_ps(_mm_cmplt_ps(speed2, vrestSpeed2), _mm_cmplt_ps(_mm_mul_ps(w, w), vrestSpin2));
+            if (_mm_movemask_ps(_mm_and_ps(contact, still)) != 0xF) resting = false;
+
+            _mm_storeu_ps(&velocityX[i], vx);
+            _mm_storeu_ps(&velocityY[i], vy);
+            _mm_storeu_ps(&velocityZ[i], vz);
+            _mm_storeu_ps(&spin[i], w);
+            _mm_storeu_ps(&offsetX[i], ox);
+            _mm_storeu_ps(&offsetY[i], oy);
+            _mm_storeu_ps(&offsetZ[i], oz);
+            _mm_storeu_ps(&angle[i], a);
+
+            // SoA -> one (x, y, z, angle) texel per fragment
+            _MM_TRANSPOSE4_PS(ox, oy, oz, a);
+            _mm_storeu_ps(out + 4 * i, ox);
+            _mm_storeu_ps(out + 4 * i + 4, oy);
+            _mm_storeu_ps(out + 4 * i + 8, oz);
+            _mm_storeu_ps(out + 4 * i + 12, a);
+        }
+#endif
+        for (; i < end; i++) {
+            velocityY[i] += gravityStep;
+            offsetX[i] += velocityX[i] * dt;
+            offsetY[i] += velocityY[i] * dt;
+            offsetZ[i] += velocityZ[i] * dt;
+            angle[i] += spin[i] * dt;
+
+            bool contact = offsetY[i] < restOffsetY[i];
+            if (contact) {
+                offsetY[i] = restOffsetY[i];
+                if (velocityY[i] < 0.0f) velocityY[i] *= -restitution;
+                velocityX[i] *= damping;
+                velocityZ[i] *= damping;
+                spin[i] *= damping;
+            }
+            float speed2 = velocityX[i] * velocityX[i] + velocityY[i] * velocityY[i] + velocityZ[i] * velocityZ[i];
+            if (!contact || speed2 >= restSpeed2 || spin[i] * spin[i] >= restSpin2) resting = false;
+            transforms[i] = glm::vec4(offsetX[i], offsetY[i], offsetZ[i], angle[i]);
+        }
+        return resting;
+    }
+
+#if defined(__SSE2__)
+    // Per-lane mask ? a : b
+    static __m128 select(__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+#endif
+};
+
+#endif // FRAGMENT_SIMULATION_H
@@ -0,0 +1,222 @@
+#ifndef FRUSTUM_CULLING_H
+#define FRUSTUM_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// View-frustum culling over a flat bounding volume hierarchy.
+//
+// Nodes are stored depth first with the index of the node after their subtree, so the
+// traversal is a loop without a stack: a box outside the frustum skips its subtree, a box
+// fully inside accepts every object below it without further tests, and leaves test their
+// objects' bounding spheres four at a time.
+
+// Bounds of one cullable object
+struct CullBounds {
+    glm::vec3 min;    // Axis-aligned box
+    glm::vec3 max;
+    glm::vec3 center; // Bounding sphere
+    float radius;
+};
+
+// Counters of the last cull, shown in the stats UI
+struct CullStats {
+    int objects = 0;       // Objects in the hierarchy
+    int visible = 0;
+    int culled = 0;
+    int nodesVisited = 0;
+    int spheresTested = 0; // Objects tested one by one; subtrees fully inside skip the test
+    float cullMs = 0.0f;
+};
+
+// Six planes (a, b, c, d) with unit normals pointing into the frustum
+struct Frustum {
+    enum Containment { OUTSIDE, INTERSECTS, INSIDE };
+
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+
+    // Planes of clip = matrix * p (Gribb and Hartmann). For projection * view they are in
+    // world space; with the model matrix included, in model space.
+    explicit Frustum(const glm::mat4& matrix) {
+        glm::vec4 rows[4];
+        for (int r = 0; r < 4; r++) {
+            rows[r] = glm::vec4(matrix[0][r], matrix[1][r], matrix[2][r], matrix[3][r]);
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            planes[2 * axis] = rows[3] + rows[axis];
+            planes[2 * axis + 1] = rows[3] - rows[axis];
+        }
+        for (glm::vec4& plane : planes) {
+            plane = plane / glm::length(glm::vec3(plane));
+        }
+    }
+
+    Containment testBox(const glm::vec3& min, const glm::vec3& max) const {
+        Containment result = INSIDE;
+        for (const glm::vec4& plane : planes) {
+            // Corner furthest along the plane normal, and the one opposite it
+            glm::vec3 positive(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y,
+                               plane.z >= 0.0f ? max.z : min.z);
+            glm::vec3 negative(plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y,
+                               plane.z >= 0.0f ? min.z : max.z);
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) return OUTSIDE;
+            if (glm::dot(glm::vec3(plane), negative) + plane.w < 0.0f) result = INTERSECTS;
+        }
+        return result;
+    }
+
+    bool testSphere(const glm::vec3& center, float radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+        }
+        return true;
+    }
+};
+
+class CullingBVH {
+public:
+    static constexpr int LEAF_SIZE = 4; // Objects per leaf, one SIMD sphere test
+
+    bool empty() const { return nodes.empty(); }
+    size_t size() const { return order.size(); }
+
+    // Builds the hierarchy by splitting at the median center along the longest axis
+    void build(const std::vector<CullBounds>& objects) {
+        nodes.clear();
+        order.resize(objects.size());
+        for (size_t i = 0; i < objects.size(); i++) order[i] = (int)i;
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        radius.clear();
+        if (!objects.empty()) {
+            buildNode(objects, 0, (int)objects.size());
+        }
+    }
+
+    // Appends the indices of the objects whose bounds touch the frustum
+    void cull(const Frustum& frustum, std::vector<int>& visible, CullStats& stats) const {
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t firstVisible = visible.size();
+        stats.objects = (int)order.size();
+        stats.nodesVisited = 0;
+        stats.spheresTested = 0;
+
+        int i = 0;
+        while (i < (int)nodes.size()) {
+            const Node& node = nodes[i];
+            stats.nodesVisited++;
+            Frustum::Containment containment = frustum.testBox(node.min, node.max);
+            if (containment == Frustum::INSIDE) {
+                visible.insert(visible.end(), order.begin() + node.firstObject,
+                               order.begin() + node.firstObject + node.objectCount);
+            } else if (containment == Frustum::INTERSECTS && node.leaf >= 0) {
+                int mask = testLeaf(frustum, node.leaf);
+                for (int k = 0; k < node.objectCount; k++) {
+                    if (mask & (1 << k)) visible.push_back(order[node.firstObject + k]);
+                }
+                stats.spheresTested += node.objectCount;
+            } else if (containment == Frustum::INTERSECTS) {
+                i++; // Descend into the first child
+                continue;
+            }
+            i = node.skip;
+        }
+
+        stats.visible = (int)(visible.size() - firstVisible);
+        stats.culled = stats.objects - stats.visible;
+        stats.cullMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+private:
+    struct Node {
+        glm::vec3 min, max;
+        int firstObject; // The subtree's objects are order[firstObject, firstObject + objectCount)
+        int objectCount;
+        int skip;        // Next node after this subtree in depth-first order
+        int leaf;        // Lane group of a leaf, -1 for inner nodes
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> order; // Object indices, grouped by leaf in depth-first order
+
+    // Bounding spheres in LEAF_SIZE lanes per leaf; unused lanes never pass the test
+    std::vector<float> centerX, centerY, centerZ, radius;
+
+    void buildNode(const std::vector<CullBounds>& objects, int first, int count) {
+        Node node;
+        node.min = glm::vec3(INFINITY);
+        node.max = glm::vec3(-INFINITY);
+        glm::vec3 centerMin(INFINITY), centerMax(-INFINITY);
+        for (int i = first; i < first + count; i++) {
+            const CullBounds& bounds = objects[order[i]];
+            node.min = glm::min(node.min, bounds.min);
+            node.max = glm::max(node.max, bounds.max);
+            centerMin = glm::min(centerMin, bounds.center);
+            centerMax = glm::max(centerMax, bounds.center);
+        }
+        node.firstObject = first;
+        node.objectCount = count;
+        node.leaf = -1;
+
+        int index = (int)nodes.size();
+        nodes.push_back(node);
+        if (count <= LEAF_SIZE) {
+            nodes[index].leaf = (int)(radius.size() / LEAF_SIZE);
+            for (int k = 0; k < LEAF_SIZE; k++) {
+                bool used = k < count;
+                const CullBounds& bounds = objects[order[first + (used ? k : 0)]];
+                centerX.push_back(bounds.center.x);
+                centerY.push_back(bounds.center.y);
+                centerZ.push_back(bounds.center.z);
+                radius.push_back(used ? bounds.radius : -1.0e30f);
+            }
+        } else {
+            glm::vec3 extent = centerMax - centerMin;
+            int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+            int middle = first + count / 2;
+            std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+                             [&](int a, int b) { return objects[a].center[axis] < objects[b].center[axis]; });
+            buildNode(objects, first, middle - first);
+            buildNode(objects, middle, first + count - middle);
+        }
+        nodes[index].skip = (int)nodes.size();
+    }
+
+    // Bit k is set if sphere k of the leaf touches the frustum
+    int testLeaf(const Frustum& frustum, int leaf) const {
+        size_t lane = (size_t)leaf * LEAF_SIZE;
+#if defined(__SSE2__)
+        const __m128 x = _mm_loadu_ps(&centerX[lane]);
+        const __m128 y = _mm_loadu_ps(&centerY[lane]);
+        const __m128 z = _mm_loadu_ps(&centerZ[lane]);
+        const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[lane]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        return _mm_movemask_ps(inside);
+#else
+        int mask = 0;
+        for (int k = 0; k < LEAF_SIZE; k++) {
+            glm::vec3 center(centerX[lane + k], centerY[lane + k], centerZ[lane + k]);
+            if (frustum.testSphere(center, radius[lane + k])) mask |= 1 << k;
+        }
+        return mask;
+#endif
+    }
+};
+
+#endif // FRUSTUM_CULLING_H
@@ -0,0 +1,72 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include "../glad/glad.h"
+
+#include <cstring>
+
+// Optional extensions that glad was not generated with. Their entry points are loaded by
+// hand once the context exists.
+
+// GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// Set by initParallelShaderCompile when compiles and links may finish asynchronously and
+// GL_COMPLETION_STATUS_KHR can be polled
+bool parallelShaderCompile = false;
+
+/**
+ * Whether the current context advertises an extension.
+ * @param name Full extension name, e.g. "GL_ARB_get_program_binary"
+ */
+bool hasGLExtension(const char* name) {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++) {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * Enables parallel shader compilation if the driver offers it and lets the driver pick
+ * the number of compiler threads.
+ * @param load GL function loader, as passed to gladLoadGLLoader
+ * @return true if compile and link status can be polled without blocking
+ */
+bool initParallelShaderCompile(GLADloadproc load) {
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxThreads = NULL;
+    if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+        maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+    } else if (hasGLExtension("GL_ARB_parallel_shader_compile")) {
+        maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+    }
+    if (maxThreads) {
+        maxThreads(0xFFFFFFFFu);
+    }
+    parallelShaderCompile = maxThreads != NULL;
+    return parallelShaderCompile;
+}
+
+// Set by initMultiDrawIndirect when glMultiDrawElementsIndirect can be called
+bool multiDrawIndirect = false;
+
+/**
+ * Finds glMultiDrawElementsIndirect, core since 4.3 and loaded by glad there, or from
+ * GL_ARB_multi_draw_indirect on older contexts.
+ * @param load GL function loader, as passed to gladLoadGLLoader
+ * @return true if indirect multi-draws are available
+ */
+bool initMultiDrawIndirect(GLADloadproc load) {
+    if (!GLAD_GL_VERSION_4_3 && hasGLExtension("GL_ARB_multi_draw_indirect")) {
+        glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+    }
+    multiDrawIndirect = glad_glMultiDrawElementsIndirect != NULL;
+    return multiDrawIndirect;
+}
+
+#endif // GL_EXTENSIONS_H
@@ -0,0 +1,144 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "../glad/glad.h"
+
+#include <cstdint>
+#include "profiler.h"
+
+// GPU timing zones on the "GPU" track of the profiler. Each zone takes a GL_TIMESTAMP
+// query where it starts and a GL_TIME_ELAPSED query around it; results are read back
+// FRAME_LATENCY frames later so the CPU never waits for the GPU to catch up. Timestamps are
+// mapped onto the CPU clock with an offset sampled every few hundred frames.
+//
+// GL_TIME_ELAPSED queries cannot nest, so GPU zones must not either; a zone opened inside
+// another one is ignored.
+class GpuProfiler {
+public:
+    static constexpr int FRAME_LATENCY = 4; // Frames in flight before results are read
+    static constexpr int MAX_ZONES = 16;    // Per frame; later zones are ignored
+    static constexpr int CALIBRATION_INTERVAL = 256;
+
+    double lastFrameMs = 0.0; // Sum of the zones of the newest frame read back
+
+    GpuProfiler() = default;
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    ~GpuProfiler() {
+        if (created) {
+            glDeleteQueries(FRAME_LATENCY * MAX_ZONES, elapsedQueries);
+            glDeleteQueries(FRAME_LATENCY * MAX_ZONES, timestampQueries);
+        }
+    }
+
+    // Allocates the queries; needs a current context
+    void create() {
+        glGenQueries(FRAME_LATENCY * MAX_ZONES, elapsedQueries);
+        glGenQueries(FRAME_LATENCY * MAX_ZONES, timestampQueries);
+        track = &profiler.addTrack("GPU");
+        created = true;
+    }
+
+    // Reads back the zones of the frame whose queries are about to be reused
+    void beginFrame() {
+        if (!created) return;
+        Frame& frame = frames[frameIndex % FRAME_LATENCY];
+        if (frame.count > 0) {
+            collect(frame, frameIndex % FRAME_LATENCY);
+        }
+        frame.count = 0;
+        if (frameIndex % CALIBRATION_INTERVAL == 0) {
+            calibrate();
+        }
+        frameIndex++;
+    }
+
+    /**
+     * Opens a zone on the current frame.
+     * @return false if the zone is not recorded (profiler paused, nested or too many zones)
+     */
+    bool begin(const char* name) {
+        if (!created || open || !profiler.enabled.load(std::memory_order_relaxed)) return false;
+        int slot = (frameIndex + FRAME_LATENCY - 1) % FRAME_LATENCY;
+        Frame& frame = frames[slot];
+        if (frame.count == MAX_ZONES) return false;
+
+        int query = slot * MAX_ZONES + frame.count;
+        if (frame.count == 0) frame.issuedNs = profiler.now();
+        frame.names[frame.count++] = name;
+        glQueryCounter(timestampQueries[query], GL_TIMESTAMP);
+        glBeginQuery(GL_TIME_ELAPSED, elapsedQueries[query]);
+        open = true;
+        return true;
+    }
+
+    void end() {
+        glEndQuery(GL_TIME_ELAPSED);
+        open = false;
+    }
+
+private:
+    struct Frame {
+        const char* names[MAX_ZONES];
+        int count = 0;
+        int64_t issuedNs = 0; // CPU time of the first zone
+    };
+
+    unsigned int elapsedQueries[FRAME_LATENCY * MAX_ZONES] = {0};
+    unsigned int timestampQueries[FRAME_LATENCY * MAX_ZONES] = {0};
+    Frame frames[FRAME_LATENCY];
+    ProfilerThread* track = nullptr;
+    int frameIndex = 0;
+    int64_t gpuToCpuNs = 0;
+    bool created = false;
+    bool open = false;
+
+    // GL_TIMESTAMP read directly is the GPU time when the previous commands reached it,
+    // close enough to line GPU zones up with the CPU zones that issued them
+    void calibrate() {
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuToCpuNs = profiler.now() - gpuNow;
+    }
+
+    // Some drivers (seen on llvmpipe) return garbage for the first query of a context; a
+    // zone that took longer than the wall time since its frame was issued is dropped
+    void collect(const Frame& frame, int slot) {
+        int64_t sinceIssuedNs = profiler.now() - frame.issuedNs;
+        double totalMs = 0.0;
+        for (int i = 0; i < frame.count; i++) {
+            GLuint64 start = 0, elapsed = 0;
+            glGetQueryObjectui64v(timestampQueries[slot * MAX_ZONES + i], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(elapsedQueries[slot * MAX_ZONES + i], GL_QUERY_RESULT, &elapsed);
+            if ((int64_t)elapsed > sinceIssuedNs) continue;
+            int64_t startNs = (int64_t)start + gpuToCpuNs;
+            track->push({frame.names[i], startNs, startNs + (int64_t)elapsed, 0});
+            totalMs += elapsed / 1.0e6;
+        }
+        lastFrameMs = totalMs;
+    }
+};
+
+// Times its own lifetime on the GPU
+class GpuZone {
+public:
+    GpuZone(GpuProfiler& gpuProfiler, const char* name) : gpuProfiler(gpuProfiler) {
+        recording = gpuProfiler.begin(name);
+    }
+
+    ~GpuZone() {
+        if (recording) gpuProfiler.end();
+    }
+
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+    GpuProfiler& gpuProfiler;
+    bool recording = false;
+};
+
+#define PROFILE_GPU_ZONE(gpuProfiler, name) GpuZone PROFILE_CONCAT(gpuZone, __LINE__)(gpuProfiler, name)
+
+#endif // GPU_PROFILER_H
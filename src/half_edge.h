@@ -0,0 +1,264 @@
+#ifndef HALF_EDGE_H
+#define HALF_EDGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "OFFReader.h"
+#include "parallel.h"
+#include "profiler.h"
+
+// Twin values for half-edges that have no single opposite half-edge
+const int HE_BOUNDARY = -1;     // Edge used by exactly one face
+const int HE_NON_MANIFOLD = -2; // Edge shared by more than two faces
+const int HE_FLIPPED = -3;      // Edge shared by two faces that traverse it the same way
+const int HE_DEGENERATE = -4;   // Edge whose two endpoints are the same vertex
+
+// Half-edge connectivity for the polygons of an OffModel.
+//
+// The half-edges of face f occupy [faceStart[f], faceStart[f + 1]) in CSR order, so next/prev
+// are index arithmetic and only origin, face and twin are stored per half-edge. Outgoing
+// half-edges are additionally grouped per vertex, which makes one-ring and vertex-face
+// iteration a contiguous scan that also works around non-manifold vertices.
+class HalfEdgeMesh {
+public:
+    std::vector<int> faceStart;       // Offsets of each face's half-edges (numFaces + 1 entries)
+    std::vector<int> heVertex;        // Origin vertex of each half-edge
+    std::vector<int> heFace;          // Face that owns each half-edge
+    std::vector<int> heTwin;          // Opposite half-edge or one of the HE_* markers above
+    std::vector<int> vertexStart;     // Offsets into vertexHalfEdges (numVertices + 1 entries)
+    std::vector<int> vertexHalfEdges; // Outgoing half-edges grouped by origin vertex
+    int numBoundaryEdges = 0;
+    int numNonManifoldEdges = 0;
+    int numFlippedEdges = 0;
+    int numDegenerateEdges = 0;
+
+    /**
+     * Builds the connectivity in linear time. Edges are paired through an open-addressing
+     * hash of (min, max) vertex keys that is filled by all worker threads concurrently.
+     * Faces with fewer than three sides get an empty half-edge range.
+     * @param model Pointer to the OffModel
+     */
+    void build(const OffModel* model) {
+        PROFILE_ZONE("Build topology");
+        clear();
+        if (!model) return;
+
+        int nv = model->numberOfVertices;
+        int nf = model->numberOfPolygons;
+
+        // Face offsets
+        faceStart.resize(nf + 1);
+        faceStart[0] = 0;
+        for (int f = 0; f < nf; f++) {
+            int sides = model->polygons[f].noSides;
+            faceStart[f + 1] = faceStart[f] + (sides >= 3 ? sides : 0);
+        }
+        int nh = faceStart[nf];
+
+        heVertex.resize(nh);
+        heFace.resize(nh);
+        heTwin.resize(nh);
+        parallelFor(0, nf, [&](int begin, int end) {
+            for (int f = begin; f < end; f++) {
+                for (int h = faceStart[f], j = 0; h < faceStart[f + 1]; h++, j++) {
+                    heVertex[h] = model->polygons[f].v[j];
+                    heFace[h] = f;
+                }
+            }
+        });
+
+        pairTwins();
+        buildVertexStars(nv);
+    }
+
+    void clear() {
+        faceStart.assign(1, 0);
+        heVertex.clear();
+        heFace.clear();
+        heTwin.clear();
+        vertexStart.assign(1, 0);
+        vertexHalfEdges.clear();
+        numBoundaryEdges = 0;
+        numNonManifoldEdges = 0;
+        numFlippedEdges = 0;
+        numDegenerateEdges = 0;
+    }
+
+    int numFaces() const { return (int)faceStart.size() - 1; }
+    int numVertices() const { return (int)vertexStart.size() - 1; }
+    int numHalfEdges() const { return (int)heVertex.size(); }
+
+    // Next half-edge around the same face
+    int next(int h) const {
+        int f = heFace[h];
+        return h + 1 < faceStart[f + 1] ? h + 1 : faceStart[f];
+    }
+
+    // Previous half-edge around the same face
+    int prev(int h) const {
+        int f = heFace[h];
+        return h > faceStart[f] ? h - 1 : faceStart[f + 1] - 1;
+    }
+
+    int destination(int h) const { return heVertex[next(h)]; }
+
+    bool isBoundaryEdge(int h) const { return heTwin[h] == HE_BOUNDARY; }
+    bool isNonManifoldEdge(int h) const { return heTwin[h] == HE_NON_MANIFOLD; }
+
+    // True if any edge around the vertex lacks a unique opposite half-edge
+    bool isBoundaryVertex(int v) const {
+        for (int i = vertexStart[v]; i < vertexStart[v + 1]; i++) {
+            int h = vertexHalfEdges[i];
+            if (heTwin[h] < 0 || heTwin[prev(h)] < 0) return true;
+        }
+        return false;
+    }
+
+    // Calls fn(h) for every half-edge leaving vertex v
+    template <typename Fn>
+    void forEachOutgoing(int v, Fn fn) const {
+        for (int i = vertexStart[v]; i < vertexStart[v + 1]; i++) {
+            fn(vertexHalfEdges[i]);
+        }
+    }
+
+    // Calls fn(f) for every face incident to vertex v
+    template <typename Fn>
+    void forEachVertexFace(int v, Fn fn) const {
+        for (int i = vertexStart[v]; i < vertexStart[v + 1]; i++) {
+            fn(heFace[vertexHalfEdges[i]]);
+        }
+    }
+
+    // Calls fn(u) for every vertex u adjacent to vertex v. Interior and boundary vertices
+    // report each neighbour once; neighbours across non-manifold or flipped edges may
+    // repeat. Degenerate edges are skipped, so v never reports itself.
+    template <typename Fn>
+    void forEachOneRing(int v, Fn fn) const {
+        for (int i = vertexStart[v]; i < vertexStart[v + 1]; i++) {
+            int h = vertexHalfEdges[i];
+            if (heTwin[h] != HE_DEGENERATE) fn(destination(h));
+
+            // An incoming edge without a twin leads to a neighbour no outgoing edge reaches
+            int p = prev(h);
+            if (heTwin[p] < 0 && heTwin[p] != HE_DEGENERATE) fn(heVertex[p]);
+        }
+    }
+
+private:
+    static const uint64_t EMPTY_KEY = 0;
+
+    // Undirected edge key, offset by one so zero marks an empty hash slot
+    static uint64_t edgeKey(int a, int b) {
+        uint64_t lo = (uint64_t)(a < b ? a : b);
+        uint64_t hi = (uint64_t)(a < b ? b : a);
+        return ((lo << 32) | hi) + 1;
+    }
+
+    static uint64_t hashKey(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    // Pairs half-edges sharing an undirected edge. Two half-edges only become twins if
+    // they run in opposite directions; a (v, v) half-edge never enters the hash.
+    void pairTwins() {
+        int nh = numHalfEdges();
+        if (nh == 0) return;
+
+        size_t capacity = 1;
+        while (capacity < (size_t)nh * 2) capacity <<= 1;
+        size_t mask = capacity - 1;
+
+        std::unique_ptr<std::atomic<uint64_t>[]> keys(new std::atomic<uint64_t>[capacity]);
+        std::unique_ptr<std::atomic<int>[]> counts(new std::atomic<int>[capacity]);
+        std::vector<int> first(capacity), second(capacity);
+        std::vector<int> heSlot(nh);
+
+        parallelFor(0, (int)capacity, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                keys[i].store(EMPTY_KEY, std::memory_order_relaxed);
+                counts[i].store(0, std::memory_order_relaxed);
+            }
+        });
+
+        // Insert every half-edge; the first two users of an edge record themselves
+        parallelFor(0, nh, [&](int begin, int end) {
+            for (int h = begin; h < end; h++) {
+                int a = heVertex[h], b = destination(h);
+                if (a == b) {
+                    heSlot[h] = -1;
+                    continue;
+                }
+                uint64_t key = edgeKey(a, b);
+                size_t slot = hashKey(key) & mask;
+                for (;;) {
+                    uint64_t current = keys[slot].load(std::memory_order_relaxed);
+                    if (current == EMPTY_KEY &&
+                        keys[slot].compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+                        break;
+                    }
+                    if (current == key) break;
+                    slot = (slot + 1) & mask;
+                }
+
+                int n = counts[slot].fetch_add(1, std::memory_order_relaxed);
+                if (n == 0) first[slot] = h;
+                else if (n == 1) second[slot] = h;
+                heSlot[h] = (int)slot;
+            }
+        });
+
+        // ThreadPool::run returns only after waiting on its finished condition variable
+        // for every chunk to report in under the pool mutex, and the same handoff
+        // publishes the next job, so the plain first/second writes happen before these reads
+        parallelFor(0, nh, [&](int begin, int end) {
+            for (int h = begin; h < end; h++) {
+                int slot = heSlot[h];
+                if (slot < 0) {
+                    heTwin[h] = HE_DEGENERATE;
+                    continue;
+                }
+                int n = counts[slot].load(std::memory_order_relaxed);
+                if (n == 1) heTwin[h] = HE_BOUNDARY;
+                else if (n == 2) {
+                    int twin = first[slot] == h ? second[slot] : first[slot];
+                    heTwin[h] = heVertex[h] == destination(twin) ? twin : HE_FLIPPED;
+                } else heTwin[h] = HE_NON_MANIFOLD;
+            }
+        });
+
+        for (size_t i = 0; i < capacity; i++) {
+            int n = counts[i].load(std::memory_order_relaxed);
+            if (n == 1) numBoundaryEdges++;
+            else if (n == 2 && heTwin[first[i]] == HE_FLIPPED) numFlippedEdges++;
+            else if (n > 2) numNonManifoldEdges++;
+        }
+        for (int h = 0; h < nh; h++) {
+            if (heSlot[h] < 0) numDegenerateEdges++;
+        }
+    }
+
+    // Groups outgoing half-edges by origin vertex with a counting sort
+    void buildVertexStars(int nv) {
+        vertexStart.assign(nv + 1, 0);
+        for (int v : heVertex) {
+            vertexStart[v + 1]++;
+        }
+        for (int v = 0; v < nv; v++) {
+            vertexStart[v + 1] += vertexStart[v];
+        }
+
+        vertexHalfEdges.resize(heVertex.size());
+        std::vector<int> cursor(vertexStart.begin(), vertexStart.end() - 1);
+        for (int h = 0; h < numHalfEdges(); h++) {
+            vertexHalfEdges[cursor[heVertex[h]]++] = h;
+        }
+    }
+};
+
+#endif // HALF_EDGE_H
@@ -0,0 +1,197 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "../glad/glad.h"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef MESH_VIEWER_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// Offscreen rendering without a display (--headless). The context comes from EGL, which
+// Mesa provides on machines without a GPU or X server (llvmpipe through the surfaceless
+// platform), and frames are drawn into a framebuffer object instead of a window.
+// EGL support is compiled in with `make HEADLESS=1`.
+
+// OpenGL 3.3 core context with no window. Destroying it releases the context.
+class HeadlessContext {
+public:
+    HeadlessContext() = default;
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    ~HeadlessContext() { destroy(); }
+
+#ifdef MESH_VIEWER_HEADLESS
+    /**
+     * Creates the context and makes it current on the calling thread.
+     * @return false if no display or no 3.3 core context is available
+     */
+    bool create() {
+        // Prefer the surfaceless platform, which needs neither X nor a DRM device
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) {
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        }
+        if (display == EGL_NO_DISPLAY) {
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+            std::cout << "Headless: no EGL display" << std::endl;
+            display = EGL_NO_DISPLAY;
+            return false;
+        }
+
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglBindAPI(EGL_OPENGL_API) ||
+            !eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+            std::cout << "Headless: no EGL config for desktop OpenGL" << std::endl;
+            destroy();
+            return false;
+        }
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "Headless: cannot create an OpenGL 3.3 core context" << std::endl;
+            destroy();
+            return false;
+        }
+
+        // Everything is drawn into an FBO, so no surface is needed where the driver allows it
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            const EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+            if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context)) {
+                std::cout << "Headless: cannot make the context current" << std::endl;
+                destroy();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Loader for gladLoadGLLoader and the extension helpers
+    GLADloadproc loader() const {
+        return (GLADloadproc)eglGetProcAddress;
+    }
+
+    void destroy() {
+        if (display == EGL_NO_DISPLAY) return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+        surface = EGL_NO_SURFACE;
+    }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+#else
+    bool create() {
+        std::cout << "Headless: built without EGL support; rebuild with make HEADLESS=1" << std::endl;
+        return false;
+    }
+
+    GLADloadproc loader() const {
+        return NULL;
+    }
+
+    void destroy() {}
+#endif
+};
+
+// Color and depth renderbuffers that frames are drawn into instead of a window
+class OffscreenFramebuffer {
+public:
+    int width = 0;
+    int height = 0;
+
+    OffscreenFramebuffer() = default;
+    OffscreenFramebuffer(const OffscreenFramebuffer&) = delete;
+    OffscreenFramebuffer& operator=(const OffscreenFramebuffer&) = delete;
+
+    ~OffscreenFramebuffer() {
+        if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+        if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+        if (depthBuffer) glDeleteRenderbuffers(1, &depthBuffer);
+    }
+
+    /**
+     * Creates the framebuffer, binds it and sets the viewport to cover it.
+     * @return false if the framebuffer is incomplete
+     */
+    bool create(int width, int height) {
+        this->width = width;
+        this->height = height;
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Headless: offscreen framebuffer is incomplete" << std::endl;
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        return true;
+    }
+
+    /**
+     * Writes the color buffer as a binary PPM, top row first.
+     * @return true if the file was written
+     */
+    bool writePPM(const std::string& path) const {
+        std::vector<unsigned char> pixels((size_t)width * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) return false;
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        bool ok = true;
+        for (int y = height - 1; y >= 0 && ok; y--) {
+            ok = fwrite(&pixels[(size_t)y * width * 3], 3, width, file) == (size_t)width;
+        }
+        return fclose(file) == 0 && ok;
+    }
+
+private:
+    unsigned int framebuffer = 0;
+    unsigned int colorBuffer = 0;
+    unsigned int depthBuffer = 0;
+};
+
+#endif // HEADLESS_H
@@ -0,0 +1,256 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include "../glad/glad.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "frustum_culling.h"
+#include "profiler.h"
+
+// Copies of one mesh placed by per-instance transforms and drawn with a single instanced
+// draw. The transforms are culled on the CPU every frame; the visible ones are packed to
+// the front of the instance buffer, so the draw's instance count is the visible count.
+//
+// Transform files (--instances) are either text or binary:
+//   .bin  little-endian float32, 16 per instance: a column-major 4x4 matrix
+//   other text, one instance per line, values separated by commas or whitespace:
+//           x y z                     translation
+//           x y z s                   translation and uniform scale
+//           x y z s rx ry rz          as above, then rotations about X, Y, Z in degrees
+//           16 values                 row-major 4x4 matrix
+//         Empty lines, '#' comments and a non-numeric header line are skipped.
+
+// Vertex attribute locations of the instance stream; must match vertex_shader.glsl
+const int INSTANCE_MODEL_LOCATION = 4;  // mat4, locations 4-7
+const int INSTANCE_NORMAL_LOCATION = 8; // mat3, locations 8-10
+
+// One entry of the instance buffer
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec3 normalMatrix[3]; // Columns of the inverse transpose of model's upper 3x3
+};
+
+static_assert(sizeof(InstanceData) == 100, "InstanceData must be tightly packed");
+
+/**
+ * Parses one text line of a transform file.
+ * @return false if the line holds a number of values that is not a known layout
+ */
+bool parseInstanceLine(const std::string& line, glm::mat4& transform, bool& empty) {
+    std::vector<float> values;
+    const char* p = line.c_str();
+    empty = true;
+    while (*p && *p != '#') {
+        if (*p == ',' || isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+        empty = false;
+        char* end = NULL;
+        float value = strtof(p, &end);
+        if (end == p) return false;
+        values.push_back(value);
+        p = end;
+    }
+
+    transform = glm::mat4(1.0f);
+    switch (values.size()) {
+        case 16:
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++) transform[c][r] = values[4 * r + c];
+            }
+            return true;
+        case 7:
+            transform = glm::rotate(transform, glm::radians(values[4]), glm::vec3(1.0f, 0.0f, 0.0f));
+            transform = glm::rotate(transform, glm::radians(values[5]), glm::vec3(0.0f, 1.0f, 0.0f));
+            transform = glm::rotate(transform, glm::radians(values[6]), glm::vec3(0.0f, 0.0f, 1.0f));
+            [[fallthrough]];
+        case 4:
+            transform = glm::scale(glm::mat4(1.0f), glm::vec3(values[3])) * transform;
+            [[fallthrough]];
+        case 3:
+            transform = glm::translate(glm::mat4(1.0f), glm::vec3(values[0], values[1], values[2])) * transform;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Reads the instance transforms of a text or binary transform file.
+ * @return false if the file cannot be read or is malformed
+ */
+bool loadInstanceTransforms(const std::string& path, std::vector<glm::mat4>& transforms) {
+    PROFILE_ZONE("Load instances");
+    transforms.clear();
+    bool binary = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+    std::ifstream in(path, binary ? std::ios::binary : std::ios::in);
+    if (!in) {
+        std::cout << "Failed to open instance file: " << path << std::endl;
+        return false;
+    }
+
+    if (binary) {
+        std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (bytes.size() % sizeof(glm::mat4) != 0) {
+            std::cout << "Instance file " << path << " is not a whole number of 4x4 float matrices" << std::endl;
+            return false;
+        }
+        transforms.resize(bytes.size() / sizeof(glm::mat4));
+        memcpy(transforms.data(), bytes.data(), bytes.size());
+        return true;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        size_t first = line.find_first_not_of(" \t");
+        if (lineNumber == 1 && first != std::string::npos && isalpha((unsigned char)line[first])) {
+            continue; // Column header
+        }
+        glm::mat4 transform;
+        bool empty = false;
+        if (!parseInstanceLine(line, transform, empty)) {
+            std::cout << path << ":" << lineNumber << ": expected 3, 4, 7 or 16 values" << std::endl;
+            return false;
+        }
+        if (!empty) transforms.push_back(transform);
+    }
+    return true;
+}
+
+class InstanceSet {
+public:
+    glm::vec3 center = glm::vec3(0.0f); // Of the box around every copy
+    float radius = 1.0f;                // Half the largest extent of that box, as Mesh uses
+
+    InstanceSet() = default;
+    InstanceSet(const InstanceSet&) = delete;
+    InstanceSet& operator=(const InstanceSet&) = delete;
+
+    ~InstanceSet() {
+        if (buffer) glDeleteBuffers(1, &buffer);
+    }
+
+    bool empty() const { return instances.empty(); }
+    size_t size() const { return instances.size(); }
+
+    // Instances packed at the front of the buffer by the last cull
+    GLsizei drawCount() const { return (GLsizei)uploaded.size(); }
+
+    size_t bufferBytes() const { return instances.size() * sizeof(InstanceData); }
+
+    // Placement of copy i in file order, culled or not
+    const glm::mat4& transform(size_t i) const { return instances[i].model; }
+
+    /**
+     * Prepares the copies on the CPU; needs no context.
+     * @param meshCenter, meshRadius Bounding sphere of the mesh in its own coordinates
+     */
+    void build(const std::vector<glm::mat4>& transforms, const glm::vec3& meshCenter, float meshRadius) {
+        instances.resize(transforms.size());
+        std::vector<CullBounds> bounds(transforms.size());
+        glm::vec3 min(INFINITY), max(-INFINITY);
+        for (size_t i = 0; i < transforms.size(); i++) {
+            const glm::mat4& m = transforms[i];
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(m)));
+            instances[i].model = m;
+            for (int c = 0; c < 3; c++) instances[i].normalMatrix[c] = normalMatrix[c];
+
+            // The largest axis scale bounds how far the sphere can stretch
+            float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+            glm::vec3 c = glm::vec3(m * glm::vec4(meshCenter, 1.0f));
+            float r = meshRadius * scale;
+            bounds[i] = {c - glm::vec3(r), c + glm::vec3(r), c, r};
+            min = glm::min(min, bounds[i].min);
+            max = glm::max(max, bounds[i].max);
+        }
+        if (!transforms.empty()) {
+            center = (min + max) * 0.5f;
+            glm::vec3 extent = max - min;
+            radius = std::max(0.5f * std::max(extent.x, std::max(extent.y, extent.z)), 1.0e-6f);
+        }
+        bvh.build(bounds);
+    }
+
+    // Creates the instance buffer holding every copy
+    void upload() {
+        if (!buffer) glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, bufferBytes(), instances.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        uploaded.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); i++) uploaded[i] = (int)i;
+    }
+
+    // Adds the per-instance attributes to a vertex array object
+    void attach(unsigned int vao) const {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (int c = 0; c < 4; c++) {
+            glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + c);
+            glVertexAttribPointer(INSTANCE_MODEL_LOCATION + c, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, model) + c * sizeof(glm::vec4)));
+            glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + c, 1);
+        }
+        for (int c = 0; c < 3; c++) {
+            glEnableVertexAttribArray(INSTANCE_NORMAL_LOCATION + c);
+            glVertexAttribPointer(INSTANCE_NORMAL_LOCATION + c, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, normalMatrix) + c * sizeof(glm::vec3)));
+            glVertexAttribDivisor(INSTANCE_NORMAL_LOCATION + c, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    /**
+     * Packs the copies inside the frustum to the front of the instance buffer. The buffer
+     * is only rewritten when that set changes.
+     * @param frustum Frustum in the space of the transforms, or NULL to draw every copy
+     */
+    void cull(const Frustum* frustum, CullStats& stats) {
+        visible.clear();
+        if (frustum) {
+            bvh.cull(*frustum, visible, stats);
+            // File order keeps the draw order, and so overdraw, stable as the view moves
+            std::sort(visible.begin(), visible.end());
+        } else {
+            visible.resize(instances.size());
+            for (size_t i = 0; i < instances.size(); i++) visible[i] = (int)i;
+        }
+        if (visible == uploaded) return;
+
+        PROFILE_ZONE("Compact instances");
+        compacted.resize(visible.size());
+        for (size_t k = 0; k < visible.size(); k++) compacted[k] = instances[visible[k]];
+        // Orphaned so a draw still reading the previous contents never stalls the upload
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, bufferBytes(), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, compacted.size() * sizeof(InstanceData), compacted.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        uploaded.swap(visible);
+    }
+
+private:
+    std::vector<InstanceData> instances; // Every copy, in file order
+    std::vector<InstanceData> compacted; // Visible copies, as uploaded
+    std::vector<int> uploaded;           // Copies currently at the front of the buffer
+    std::vector<int> visible;            // Scratch for the next cull
+    CullingBVH bvh;
+    unsigned int buffer = 0;
+};
+
+#endif // INSTANCING_H
@@ -9,24 +9,42 @@
 #include "../imgui/backends/imgui_impl_glfw.h"
 #include "../imgui/backends/imgui_impl_opengl3.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <random>
 #include <string>
 #include <vector>
 
 #include "shader.h"
+#include "shader_variants.h"
+#include "shader_reload.h"
 #include "camera.h"
 #include "mesh.h"
-#include "explosion_effect.h" // Add this include
+#include "scene.h"
+#include "explosion_effect.h"
+#include "clustered_lighting.h"
+#include "headless.h"
+#include "benchmark.h"
+#include "profiler.h"
+#include "gpu_profiler.h"
 
 // Window settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
 // Camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+bool cameraDirty = true;     // View matrix or position changed since the last upload
+bool projectionDirty = true; // Zoom changed since the last upload
 
 // Timing
 float deltaTime = 0.0f;
@@ -34,14 +52,16 @@ float lastFrame = 0.0f;
 
 // Lighting
 std::vector<Light> lights;
+const int NUM_USER_LIGHTS = 3; // Lights with their own controls; the rest form the point light rig
+int rigLightCount = 0;
+bool lightsDirty = true;     // A light was edited since the last upload
 bool depthColoring = false;
+bool frustumCulling = true;  // Skip meshlets (or scene meshes) outside the view
+bool indirectDraws = true;   // Scenes submit through a command buffer where supported
 float explodeFactor = 0.0f;
 bool explodeAnimation = false;
 float explodeDirection = 1.0f; // 1.0f for expanding, -1.0f for contracting
 
-// OFF model for explosion effect
-OffModel* offModel = nullptr;
-
 // Rotation settings
 float rotationAngle = 0.0f;
 glm::vec3 rotationAxis(1.0f, 0.0f, 0.0f); // Default to X axis
@@ -53,75 +73,259 @@ float rotationSpeed = 30.0f; // Degrees per second
 // ImGui control
 bool showImGuiWindow = true;
 bool captureMouse = true;
+bool showProfiler = false;
+std::string traceOutput = "trace.json"; // Chrome trace written by the profiler window or --trace
+
+// Frame pacing
+bool renderOnDemand = true;  // Sleep until something changes instead of redrawing every iteration
+bool vsync = true;
+int frameCap = 0;            // Frames per second limit, 0 for none
+int redrawFrames = 1;        // Frames still to draw before the viewer may go idle
+const int REDRAW_AFTER_EVENT = 3;       // ImGui settles hover and focus over a few frames
+const double IDLE_WAKEUP_SECONDS = 0.25; // Polls shader edits and background builds while idle
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void buildLightRig(int count);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void applyBenchmarkTimeline(int frame, int frames);
+void drawProfilerWindow(const GpuProfiler& gpuProfiler);
+void requestRedraw(int frames = REDRAW_AFTER_EVENT);
+bool sceneAnimating(const Mesh* mesh);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void char_callback(GLFWwindow* window, unsigned int codepoint);
+void window_refresh_callback(GLFWwindow* window);
 
 int main(int argc, char* argv[]) {
-    // Check if mesh file is provided
-    std::string meshFilename;
-    if (argc > 1) {
-        meshFilename = argv[1];
+    auto startupStart = std::chrono::high_resolution_clock::now();
+    profiler.setThreadName("Main");
+
+    // Check if mesh files are provided; options may appear anywhere on the command line
+    std::vector<std::string> meshPaths;
+    bool useShaderCache = true;
+    bool headless = false;
+    int headlessFrames = 1;
+    std::string headlessOutput = "frame.ppm";
+    int benchmarkFrames = 0; // Frames to record with --benchmark; 0 runs interactively
+    int benchmarkWarmup = 30;
+    std::string benchmarkOutput = "benchmark.json";
+    bool writeTrace = false;
+    std::string instanceFile; // Transforms of the copies to draw, see instancing.h
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--no-shader-cache") {
+            useShaderCache = false;
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            headlessFrames = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--output" && i + 1 < argc) {
+            headlessOutput = argv[++i];
+        } else if (arg == "--benchmark" && i + 1 < argc) {
+            benchmarkFrames = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--benchmark-warmup" && i + 1 < argc) {
+            benchmarkWarmup = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--benchmark-output" && i + 1 < argc) {
+            benchmarkOutput = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            traceOutput = argv[++i];
+            writeTrace = true;
+        } else if (arg == "--continuous") {
+            renderOnDemand = false;
+        } else if (arg == "--no-vsync") {
+            vsync = false;
+        } else if (arg == "--max-fps" && i + 1 < argc) {
+            frameCap = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--no-indirect") {
+            indirectDraws = false;
+        } else if (arg == "--instances" && i + 1 < argc) {
+            instanceFile = argv[++i];
+        } else {
+            meshPaths.push_back(arg);
+        }
+    }
+    if (meshPaths.empty()) {
+        meshPaths.push_back("models/1grm.off"); // Default mesh if none provided
+        std::cout << "No mesh file provided. Using default: " << meshPaths[0] << std::endl;
+        std::cout << "Usage: " << argv[0] << " [--no-shader-cache] [--headless [--frames N] [--output frame.ppm]]"
+                  << " [--benchmark N [--benchmark-warmup N] [--benchmark-output benchmark.json]] [--trace trace.json]"
+                  << " [--continuous] [--no-vsync] [--max-fps N] [--no-indirect] [--instances transforms.csv|.bin] <mesh_file.off | directory>..." << std::endl;
+    }
+
+    // Several files, or a directory of them, are packed into one Scene; a single file
+    // keeps the full Mesh with its explode modes
+    std::vector<std::string> meshFiles = Scene::expandPaths(meshPaths);
+    if (meshFiles.empty()) {
+        std::cout << "No OFF files found in " << meshPaths[0] << std::endl;
+        return -1;
+    }
+    bool sceneMode = meshFiles.size() > 1;
+    std::string meshFilename = sceneMode ? std::to_string(meshFiles.size()) + " meshes" : meshFiles[0];
+    if (sceneMode && !instanceFile.empty()) {
+        std::cout << "--instances places copies of a single mesh; ignored for a scene" << std::endl;
+        instanceFile.clear();
+    }
+    // Variant of the first frame, built while the mesh loads
+    ShaderFeatures startupFeatures;
+    startupFeatures.instanced = !instanceFile.empty();
+
+    // Parse the mesh on a worker while the window, context and shaders are set up. The
+    // constructor only does CPU work; its GL buffers are created after the join below.
+    std::cout << "Loading " << (sceneMode ? "scene: " : "mesh: ") << meshFilename << std::endl;
+    std::future<std::unique_ptr<Mesh>> meshLoad;
+    std::future<std::unique_ptr<Scene>> sceneLoad;
+    if (sceneMode) {
+        sceneLoad = std::async(std::launch::async, [meshFiles]() {
+            profiler.setThreadName("Mesh loader");
+            auto start = std::chrono::high_resolution_clock::now();
+            std::unique_ptr<Scene> scene(new Scene(meshFiles));
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            std::cout << "Scene parsed in " << ms << " ms" << std::endl;
+            return scene;
+        });
     } else {
-        meshFilename = "models/1grm.off"; // Default mesh if none provided
-        std::cout << "No mesh file provided. Using default: " << meshFilename << std::endl;
-        std::cout << "Usage: " << argv[0] << " <mesh_file.off>" << std::endl;
+        meshLoad = std::async(std::launch::async, [meshFilename, instanceFile]() {
+            profiler.setThreadName("Mesh loader");
+            auto start = std::chrono::high_resolution_clock::now();
+            std::unique_ptr<Mesh> mesh(new Mesh(meshFilename));
+            std::vector<glm::mat4> transforms;
+            if (!instanceFile.empty() && loadInstanceTransforms(instanceFile, transforms)) {
+                mesh->setInstances(transforms);
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            std::cout << "Mesh parsed in " << ms << " ms" << std::endl;
+            return mesh;
+        });
     }
 
-    // Initialize GLFW
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Create the context: a GLFW window, or with --headless an EGL context drawing into an
+    // offscreen framebuffer. Everything after this is shared by both.
+    GLFWwindow* window = NULL;
+    HeadlessContext headlessContext;
+    OffscreenFramebuffer offscreen;
+    GLADloadproc loadProc = (GLADloadproc)glfwGetProcAddress;
+    if (headless) {
+        if (!headlessContext.create()) {
+            return -1;
+        }
+        loadProc = headlessContext.loader();
+    } else {
+        // Initialize GLFW
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    // Create window
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "3D Mesh Viewer", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        // Create window
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "3D Mesh Viewer", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        // Registered before ImGui, which chains to them, so any input wakes the render loop
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetCharCallback(window, char_callback);
+        glfwSetWindowRefreshCallback(window, window_refresh_callback);
+        glfwSwapInterval(vsync ? 1 : 0);
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
 
     // Initialize GLAD
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    if (!gladLoadGLLoader(loadProc)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    if (useShaderCache && !initProgramCache(loadProc)) {
+        std::cout << "Program binaries not supported; shader cache disabled" << std::endl;
+    }
+    if (initParallelShaderCompile(loadProc)) {
+        std::cout << "Parallel shader compile available" << std::endl;
+    }
+    if (initMultiDrawIndirect(loadProc) && sceneMode) {
+        std::cout << "Indirect multi-draw available" << std::endl;
+    }
 
-    // Setup ImGui
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    ImGui::StyleColorsDark();
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330");
+    if (headless) {
+        std::cout << "Headless rendering on " << glGetString(GL_RENDERER) << std::endl;
+        if (!offscreen.create(SCR_WIDTH, SCR_HEIGHT)) {
+            return -1;
+        }
+        framebufferWidth = offscreen.width;
+        framebufferHeight = offscreen.height;
+    } else {
+        // Setup ImGui
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO(); (void)io;
+        ImGui::StyleColorsDark();
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330");
+    }
 
     // Configure global OpenGL state
     glEnable(GL_DEPTH_TEST);
 
     // Build and compile shaders
-    Shader shader("shaders/vertex_shader.glsl", "shaders/fragment_shader.glsl");
+    // One specialised program per feature set; samplers are assigned when each is built
+    ShaderVariants shaders("shaders/vertex_shader.glsl", "shaders/fragment_shader.glsl", [](Shader& shader) {
+        shader.setInt("explodeKeyframes", KEYFRAME_TEXTURE_UNIT);
+        shader.setInt("fragmentTransforms", FRAGMENT_TEXTURE_UNIT);
+        shader.setInt("lightData", LIGHT_DATA_TEXTURE_UNIT);
+        shader.setInt("clusterGrid", CLUSTER_GRID_TEXTURE_UNIT);
+        shader.setInt("clusterLights", CLUSTER_LIGHTS_TEXTURE_UNIT);
+    });
+    // With parallel compile the driver builds every variant while the mesh is parsed;
+    // otherwise only the first frame's variant is compiled here, the rest one per frame
+    if (parallelShaderCompile) {
+        shaders.startAll();
+    } else {
+        shaders.get(startupFeatures);
+    }
 
-    // Load the mesh from OFF file
-    std::cout << "Loading mesh: " << meshFilename << std::endl;
-    Mesh mesh(meshFilename);
-    mesh.setupMesh();
-    std::cout << "Mesh loaded with " << mesh.vertices.size() << " vertices and " 
-              << mesh.indices.size() / 3 << " triangles" << std::endl;
+    // Edits to the shader files are recompiled in the background and swapped in
+    ShaderReloader shaderReloader;
+    if (window) {
+        shaderReloader.start(window, "shaders");
+    }
 
-    // Get access to the underlying OFF model for explosion effects
-    offModel = mesh.getOffModel();
-    if (offModel) {
-        // Initialize explosion data
-        initializeExplosion(offModel);
+    // Join the mesh load and the first frame's program. Exactly one of mesh and scene is
+    // set; the explode controls exist for a single mesh only.
+    std::unique_ptr<Mesh> loadedMesh;
+    std::unique_ptr<Scene> scene;
+    if (sceneMode) {
+        scene = sceneLoad.get();
+        scene->setupScene();
+    } else {
+        loadedMesh = meshLoad.get();
+        loadedMesh->setupMesh();
+    }
+    Mesh* mesh = loadedMesh.get();
+    Shader& startupShader = shaders.get(startupFeatures);
+    std::cout << "Shader program " << (startupShader.loadedFromCache ? "loaded from cache" : "compiled")
+              << " in " << startupShader.buildMs << " ms" << (programCacheEnabled ? "" : " (cache disabled)") << std::endl;
+    if (scene) {
+        std::cout << "Scene loaded with " << scene->meshes.size() << " meshes, " << scene->vertices.size()
+                  << " vertices and " << scene->triangleCount() << " triangles" << std::endl;
+    } else {
+        std::cout << "Mesh loaded with " << mesh->vertices.size() << " vertices and " 
+                  << mesh->indices.size() / 3 << " triangles" << std::endl;
+        std::cout << "Topology: " << mesh->topology.numBoundaryEdges << " boundary edges, "
+                  << mesh->topology.numNonManifoldEdges << " non-manifold edges, "
+                  << mesh->topology.numFlippedEdges << " flipped edges, "
+                  << mesh->topology.numDegenerateEdges << " degenerate edges" << std::endl;
+        std::cout << "Connected parts: " << mesh->parts.numParts
+                  << (mesh->hasParts() ? " (exploding parts rigidly)" : "") << std::endl;
+        if (mesh->instanced()) {
+            std::cout << "Instances: " << mesh->instances.size() << " from " << instanceFile << std::endl;
+        }
     }
 
     // Setup lights
@@ -148,34 +352,121 @@ int main(int argc, char* argv[]) {
         glm::vec3(0.7f, 0.7f, 0.7f),
         false
     ));
+
+    // Shared uniform blocks; only ranges marked dirty are uploaded each frame
+    UniformBuffer<FrameBlock> frameBlock;
+    UniformBuffer<LightBlock> lightBlock;
+    UniformBuffer<MaterialBlock> materialBlock;
+    UniformBuffer<ObjectBlock> objectBlock;
+    frameBlock.data.minDepth = 0.1f;
+    frameBlock.data.maxDepth = 10.0f;
+    materialBlock.data.objectColor = glm::vec3(0.8f, 0.8f, 0.8f);
+    materialBlock.data.shininess = 32.0f;
+    frameBlock.create(FRAME_BLOCK_BINDING);
+    lightBlock.create(LIGHT_BLOCK_BINDING);
+    materialBlock.create(MATERIAL_BLOCK_BINDING);
+    objectBlock.create(OBJECT_BLOCK_BINDING);
+
+    // Lights are assigned to froxels whenever the view, projection or lights change
+    ClusteredLighting clusteredLighting;
+    clusteredLighting.create();
+    const float nearPlane = 0.1f, farPlane = 100.0f;
     
+    // Benchmark runs replace input and wall-clock time with a scripted timeline at a
+    // fixed step, so every run renders the same frames
+    FrameBenchmark benchmark;
+    bool benchmarking = benchmarkFrames > 0;
+    // GPU zones time the frame phases; they are left off during a benchmark, whose own
+    // timer query spans the frame and cannot be nested with theirs
+    GpuProfiler gpuProfiler;
+    if (benchmarking) {
+        benchmark.create(benchmarkFrames, benchmarkWarmup);
+        headlessFrames = benchmark.totalFrames();
+        autoRotate = false;
+        showImGuiWindow = false;
+        // Every variant the timeline may switch to is built before the first timed frame
+        for (uint32_t key = 0; key < (uint32_t)ShaderVariants::count(); key++) {
+            shaders.get(ShaderFeatures::fromKey(key));
+        }
+        if (window) glfwSwapInterval(0);
+        std::cout << "Benchmark: " << benchmarkWarmup << " warm-up + " << benchmarkFrames << " frames" << std::endl;
+    } else {
+        gpuProfiler.create();
+    }
+
     // Print controls
-    std::cout << "\n=== Controls ===\n";
-    std::cout << "WASD: Move camera\n";
-    std::cout << "QE: Move camera up/down\n";
-    std::cout << "Mouse: Look around\n";
-    std::cout << "B: Toggle explode animation\n";
-    std::cout << "R: Toggle auto-rotation\n";
-    std::cout << "Space: Change rotation axis\n";
-    std::cout << "Tab: Toggle ImGui window/mouse capture\n";
-    std::cout << "ESC: Exit\n";
+    if (window && !benchmarking) {
+        std::cout << "\n=== Controls ===\n";
+        std::cout << "WASD: Move camera\n";
+        std::cout << "QE: Move camera up/down\n";
+        std::cout << "Mouse: Look around\n";
+        std::cout << "B: Toggle explode animation\n";
+        std::cout << "R: Toggle auto-rotation\n";
+        std::cout << "Space: Change rotation axis\n";
+        std::cout << "Tab: Toggle ImGui window/mouse capture\n";
+        std::cout << "P: Toggle profiler window\n";
+        std::cout << "ESC: Exit\n";
+    }
 
     // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        // Per-frame time logic
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+    bool firstFrame = true;
+    int frameCount = 0;
+    while (window ? !glfwWindowShouldClose(window) : frameCount < headlessFrames) {
+        // Render on demand: while nothing on screen can change, sleep in the event wait
+        // instead of redrawing. Input and state changes request frames; the timeout keeps
+        // shader reload and background builds moving, and idle time precompiles variants.
+        if (window && renderOnDemand && !benchmarking && redrawFrames == 0 && !sceneAnimating(mesh)) {
+            bool variantsLeft = shaders.size() < (size_t)ShaderVariants::count();
+            glfwWaitEventsTimeout(variantsLeft ? 0.01 : IDLE_WAKEUP_SECONDS);
+            if (shaderReloader.update(shaders) || (mesh && mesh->isExplodedStreamBuilding())) {
+                requestRedraw(1);
+            }
+            shaders.precompileNext();
+            if (redrawFrames == 0) continue;
+
+            // Resume without a time step spanning the idle period
+            lastFrame = glfwGetTime();
+        }
+        if (redrawFrames > 0) redrawFrames--;
+        double frameStartTime = window ? glfwGetTime() : 0.0;
 
-        // Process input
-        processInput(window);
+        profiler.markFrame();
+        PROFILE_ZONE("Frame");
+        gpuProfiler.beginFrame();
+
+        // Per-frame time logic; headless frames advance at a fixed 60 Hz
+        if (window) {
+            PROFILE_ZONE("Input");
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            // Process input
+            if (!benchmarking) processInput(window);
+        } else {
+            deltaTime = 1.0f / 60.0f;
+        }
+        if (benchmarking) {
+            if (benchmark.done()) break;
+            deltaTime = 1.0f / 60.0f;
+            applyBenchmarkTimeline(benchmark.frame(), benchmark.totalFrames());
+            benchmark.beginFrame();
+        }
 
         // Update rotation angle if auto-rotate is enabled
+        ProfileZone updateZone("Update");
         if (autoRotate) {
             rotationAngle += rotationSpeed * deltaTime; // Use rotationSpeed instead of hardcoded 30.0f
             if (rotationAngle > 360.0f) rotationAngle -= 360.0f;
         }
         
+        // In physics mode the explode trigger throws the fragments instead of ramping
+        if (mesh && explodeAnimation && mesh->explodeMode == EXPLODE_SIMULATED) {
+            mesh->launchSimulation();
+            explodeAnimation = false;
+        }
+        if (mesh) mesh->updateSimulation(deltaTime);
+
         // Update explosion effect if animation is active
         if (explodeAnimation) {
             explodeFactor += explodeDirection * deltaTime;
@@ -188,38 +479,102 @@ int main(int argc, char* argv[]) {
                 explodeDirection = 1.0f;
                 explodeAnimation = false;
             }
-            
-            // Apply explosion effect to the model
-            if (offModel) {
-                updateExplosion(offModel, explodeFactor);
-            }
+            // The vertex shader applies the explosion; no per-frame CPU work
         }
+        updateZone.end();
 
         // Clear the screen
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            PROFILE_GPU_ZONE(gpuProfiler, "Clear");
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
         // Start ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
+        ProfileZone uiZone("ImGui build");
+        if (window) {
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+        }
 
         // ImGui panel for light and rotation controls
-        if (showImGuiWindow) {
+        if (window && showImGuiWindow) {
             ImGui::Begin("Controls");
             
             // General settings
             if (ImGui::CollapsingHeader("General Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
                 ImGui::Checkbox("Depth-based Coloring", &depthColoring);
-                if (ImGui::Button("Explode View")) {
-                    explodeAnimation = true;
-                    explodeDirection = explodeFactor > 0.5f ? -1.0f : 1.0f;
+                if (mesh) {
+                    if (ImGui::Button("Explode View")) {
+                        explodeAnimation = true;
+                        explodeDirection = explodeFactor > 0.5f ? -1.0f : 1.0f;
+                    }
+                    ImGui::SameLine();
+                    ImGui::SliderFloat("Explode Factor", &explodeFactor, 0.0f, 1.0f);
+                    if (mesh->hasParts()) {
+                        // Baked mode plays the keyframes with the explode factor as time;
+                        // physics mode is started by Explode View and ignores the factor
+                        const char* modes[] = {"Direct", "Baked Animation", "Physics"};
+                        int mode = mesh->explodeMode;
+                        if (ImGui::Combo("Explode Mode", &mode, modes, 3)) {
+                            mesh->explodeMode = (ExplodeMode)mode;
+                            mesh->resetSimulation();
+                        }
+                        if (mesh->explodeMode == EXPLODE_SIMULATED) {
+                            ImGui::Text("Simulation: %zu fragments, %.3f ms%s", mesh->simulation.size(), mesh->getSimulationMs(),
+                                        mesh->simulation.running ? "" : ", at rest");
+                        }
+                    }
+                    if (ImGui::Button("Export Exploded OFF")) {
+                        // CPU-side exploded geometry is evaluated only here, on request
+                        bool written = mesh->exportExploded("exploded.off", explodeFactor);
+                        std::cout << (written ? "Exported exploded mesh to exploded.off" : "Failed to write exploded.off") << std::endl;
+                    }
                 }
-                ImGui::SameLine();
-                if (ImGui::SliderFloat("Explode Factor", &explodeFactor, 0.0f, 1.0f)) {
-                    // Apply explosion effect when slider is moved
-                    if (offModel) {
-                        updateExplosion(offModel, explodeFactor);
+
+                ImGui::Checkbox("Profiler", &showProfiler);
+                ImGui::Checkbox("Frustum Culling", &frustumCulling);
+                const CullStats& cullStats = mesh ? mesh->cullStats : scene->cullStats;
+                if (frustumCulling && cullStats.objects > 0) {
+                    const char* culledUnit = scene ? "Meshes" : (mesh->instanced() ? "Instances" : "Meshlets");
+                    ImGui::Text("%s: %d drawn, %d culled of %d", culledUnit, cullStats.visible,
+                                cullStats.culled, cullStats.objects);
+                    ImGui::Text("Cull: %d nodes, %d spheres, %.3f ms", cullStats.nodesVisited,
+                                cullStats.spheresTested, cullStats.cullMs);
+                }
+                if (scene && scene->supportsIndirect()) {
+                    ImGui::Checkbox("Indirect Draws", &indirectDraws);
+                }
+                ImGui::Text("Draw calls: %d, triangles: %lld", renderStats.drawCalls, renderStats.triangles);
+                ImGui::Text("Shader variants: %zu / %d built", shaders.size(), ShaderVariants::count());
+                if (shaderReloader.reloading) {
+                    ImGui::Text("Shader reload: compiling...");
+                } else if (shaderReloader.reloadCount > 0 || !shaderReloader.lastReloadOk) {
+                    ImGui::Text("Shader reload: %s (%.1f ms)", shaderReloader.lastReloadOk ? "ok" : "failed, previous kept",
+                                shaderReloader.lastReloadMs);
+                }
+
+                // Memory trade-off between the welded and unwelded layouts
+                if (scene) {
+                    ImGui::Text("Scene: %zu meshes, %zu triangles", scene->meshes.size(), scene->triangleCount());
+                    ImGui::Text("Shared arenas: %.2f MB", scene->arenaBytes() / (1024.0f * 1024.0f));
+                } else {
+                    ImGui::Text("Connected parts: %d", mesh->parts.numParts);
+                    ImGui::Text("Welded buffers: %.2f MB", mesh->weldedBytes() / (1024.0f * 1024.0f));
+                    if (mesh->instanced()) {
+                        ImGui::Text("Instances: %zu, buffer %.2f MB", mesh->instances.size(),
+                                    mesh->instances.bufferBytes() / (1024.0f * 1024.0f));
+                    }
+                    if (mesh->hasParts()) {
+                        ImGui::Text("Explode stream: not needed (rigid parts)");
+                        ImGui::Text("Baked keyframes: %.2f MB", mesh->animationBytes() / (1024.0f * 1024.0f));
+                    } else if (mesh->isExplodedStreamBuilding()) {
+                        ImGui::Text("Explode stream: building...");
+                    } else if (mesh->explodedBytes() > 0) {
+                        ImGui::Text("Explode stream: %.2f MB", mesh->explodedBytes() / (1024.0f * 1024.0f));
+                    } else {
+                        ImGui::Text("Explode stream: not built");
                     }
                 }
             }
@@ -265,89 +620,208 @@ int main(int argc, char* argv[]) {
             
             ImGui::Separator();
             
+            // Redraw policy; with render on demand an idle viewer stops drawing altogether
+            if (ImGui::CollapsingHeader("Frame Pacing")) {
+                ImGui::Checkbox("Render on Demand", &renderOnDemand);
+                if (ImGui::Checkbox("VSync", &vsync)) {
+                    glfwSwapInterval(vsync ? 1 : 0);
+                }
+                ImGui::SliderInt("Frame Cap", &frameCap, 0, 240, frameCap == 0 ? "off" : "%d fps");
+                ImGui::Text("Frames drawn: %d", frameCount);
+            }
+
+            // Point light rig for testing many lights
+            if (ImGui::CollapsingHeader("Point Light Rig")) {
+                if (ImGui::SliderInt("Rig Lights", &rigLightCount, 0, 512)) {
+                    buildLightRig(rigLightCount);
+                }
+                ImGui::Text("Active lights: %d", clusteredLighting.lightCount());
+                ImGui::Text("Per froxel: %.2f avg, %d max", 
+                    (float)clusteredLighting.totalClusterLights / ClusteredLighting::NUM_CLUSTERS,
+                    clusteredLighting.maxClusterLights);
+                ImGui::Text("Assignment: %.3f ms", clusteredLighting.assignMs);
+                if (clusteredLighting.droppedLights > 0) {
+                    ImGui::Text("Dropped (froxel full): %d", clusteredLighting.droppedLights);
+                }
+            }
+
             // Light controls
-            for (int i = 0; i < lights.size(); i++) {
+            for (int i = 0; i < NUM_USER_LIGHTS; i++) {
                 std::string lightLabel = "Light " + std::to_string(i + 1);
                 if (ImGui::CollapsingHeader(lightLabel.c_str())) {
                     std::string enableId = "Enabled##" + std::to_string(i);
-                    ImGui::Checkbox(enableId.c_str(), &lights[i].enabled);
+                    lightsDirty |= ImGui::Checkbox(enableId.c_str(), &lights[i].enabled);
                     
                     std::string posId = "Position##" + std::to_string(i);
-                    ImGui::DragFloat3(posId.c_str(), &lights[i].position.x, 0.1f);
+                    lightsDirty |= ImGui::DragFloat3(posId.c_str(), &lights[i].position.x, 0.1f);
                     
                     std::string ambId = "Ambient##" + std::to_string(i);
-                    ImGui::ColorEdit3(ambId.c_str(), &lights[i].ambient.x);
+                    lightsDirty |= ImGui::ColorEdit3(ambId.c_str(), &lights[i].ambient.x);
                     
                     std::string diffId = "Diffuse##" + std::to_string(i);
-                    ImGui::ColorEdit3(diffId.c_str(), &lights[i].diffuse.x);
+                    lightsDirty |= ImGui::ColorEdit3(diffId.c_str(), &lights[i].diffuse.x);
                     
                     std::string specId = "Specular##" + std::to_string(i);
-                    ImGui::ColorEdit3(specId.c_str(), &lights[i].specular.x);
+                    lightsDirty |= ImGui::ColorEdit3(specId.c_str(), &lights[i].specular.x);
+
+                    std::string radiusId = "Radius##" + std::to_string(i);
+                    lightsDirty |= ImGui::DragFloat(radiusId.c_str(), &lights[i].radius, 0.1f, 0.1f, 100.0f);
                 }
             }
             
             ImGui::End();
         }
+        if (window && showProfiler) {
+            drawProfilerWindow(gpuProfiler);
+        }
+        uiZone.end();
 
-        // Activate shader
+        // Activate the program specialised for the current settings, picking up any
+        // shader edits that finished compiling
+        ProfileZone uniformZone("Uniforms");
+        shaderReloader.update(shaders);
+        ShaderFeatures features;
+        features.depthColor = depthColoring;
+        features.explodeMode = mesh ? mesh->shaderExplodeMode(explodeFactor) : EXPLODE_NONE;
+        features.instanced = mesh && mesh->instanced();
+        Shader& shader = shaders.get(features);
         shader.use();
 
-        // Pass object color to the shader
-        shader.setVec3("objectColor", glm::vec3(0.8f, 0.8f, 0.8f));
-        shader.setFloat("shininess", 32.0f);
-        shader.setVec3("viewPos", camera.Position);
-        shader.setBool("useDepthColor", depthColoring);
-        shader.setFloat("minDepth", 0.1f);
-        shader.setFloat("maxDepth", 10.0f);
-        
-        // Pass light properties
-        for (unsigned int i = 0; i < lights.size(); i++) {
-            std::string lightIndex = "lights[" + std::to_string(i) + "]";
-            shader.setVec3(lightIndex + ".position", lights[i].position);
-            shader.setVec3(lightIndex + ".ambient", lights[i].ambient);
-            shader.setVec3(lightIndex + ".diffuse", lights[i].diffuse);
-            shader.setVec3(lightIndex + ".specular", lights[i].specular);
-            shader.setBool(lightIndex + ".enabled", lights[i].enabled);
+        // Refresh the shared blocks from whatever changed this frame
+        bool lightingChanged = lightsDirty || cameraDirty || projectionDirty;
+        if (lightsDirty) {
+            clusteredLighting.setLights(lights);
+            lightsDirty = false;
         }
-        
-        // Pass explode factor
-        shader.setFloat("explodeFactor", explodeFactor);
+        if (cameraDirty) {
+            frameBlock.set(frameBlock.data.view, camera.GetViewMatrix());
+            frameBlock.set(frameBlock.data.viewPos, camera.Position);
+            cameraDirty = false;
+        }
+        if (projectionDirty) {
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, nearPlane, farPlane);
+            frameBlock.set(frameBlock.data.projection, projection);
+            clusteredLighting.setProjection(projection, nearPlane, farPlane);
+            projectionDirty = false;
+        }
+        if (lightingChanged) {
+            clusteredLighting.assign(frameBlock.data.view);
+            lightBlock.set(lightBlock.data.clusterDims, glm::uvec4(ClusteredLighting::GRID_X, ClusteredLighting::GRID_Y,
+                                                                   ClusteredLighting::GRID_Z, clusteredLighting.lightCount()));
+            lightBlock.set(lightBlock.data.clusterScale, glm::vec4((float)framebufferWidth, (float)framebufferHeight,
+                                                                   clusteredLighting.getSliceScale(), clusteredLighting.getSliceBias()));
+        }
+        clusteredLighting.bind();
+        frameBlock.upload();
+        lightBlock.upload();
+        materialBlock.upload();
 
-        // View/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
+        // Model transformation and its normal matrix, once per draw
+        glm::mat4 model = mesh ? mesh->getModelMatrix(rotationAngle, rotationAxis)
+                               : scene->getModelMatrix(rotationAngle, rotationAxis);
+        glm::mat3 normalMatrix = Mesh::getNormalMatrix(model);
+        objectBlock.set(objectBlock.data.model, model);
+        for (int c = 0; c < 3; c++) {
+            objectBlock.set(objectBlock.data.normalMatrix[c], glm::vec4(normalMatrix[c], 0.0f));
+        }
+        objectBlock.upload();
+        uniformZone.end();
 
-        // Model transformation
-        glm::mat4 model = mesh.getModelMatrix(rotationAngle, rotationAxis);
-        shader.setMat4("model", model);
+        // Pick the meshlets, or a scene's meshes, inside the view frustum, tested in model space
+        {
+            PROFILE_ZONE("Cull");
+            Frustum frustum(frameBlock.data.projection * frameBlock.data.view * model);
+            if (mesh) {
+                mesh->cull(frustumCulling ? &frustum : NULL, explodeFactor);
+            } else {
+                scene->cull(frustumCulling ? &frustum : NULL);
+            }
+        }
+        renderStats.reset();
 
-        // Render the mesh
-        mesh.Draw(shader);
+        // Render the mesh (Draw sets explodeFactor for the layout it uses), or the whole
+        // scene with one multi-draw
+        {
+            PROFILE_ZONE("Draw");
+            PROFILE_GPU_ZONE(gpuProfiler, "Mesh");
+            if (mesh) {
+                mesh->Draw(shader, explodeFactor);
+            } else {
+                scene->setIndirect(indirectDraws);
+                scene->Draw(shader);
+            }
+        }
 
-        // Render ImGui
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        // Build one of the remaining variants per frame so later toggles never stall
+        {
+            PROFILE_ZONE("Precompile shaders");
+            shaders.precompileNext();
+        }
+        if (benchmarking) benchmark.endFrame();
 
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // Render ImGui, then swap buffers and poll events
+        if (window) {
+            {
+                PROFILE_ZONE("ImGui render");
+                PROFILE_GPU_ZONE(gpuProfiler, "ImGui");
+                ImGui::Render();
+                ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            }
+
+            PROFILE_ZONE("Swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+
+            // Wait out the rest of the frame budget, still handling input meanwhile
+            if (frameCap > 0 && !benchmarking) {
+                PROFILE_ZONE("Frame cap");
+                double deadline = frameStartTime + 1.0 / frameCap;
+                for (double now = glfwGetTime(); now < deadline; now = glfwGetTime()) {
+                    glfwWaitEventsTimeout(deadline - now);
+                }
+            }
+        } else {
+            PROFILE_ZONE("Finish");
+            glFinish();
+        }
+        frameCount++;
+
+        if (firstFrame) {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startupStart).count();
+            std::cout << "Time to first frame: " << ms << " ms" << std::endl;
+            firstFrame = false;
+        }
     }
 
-    // Reset explosion and clean up explosion data
-    if (offModel) {
-        resetExplosion(offModel);
-        cleanupExplosionData(offModel);
+    if (benchmarking && benchmark.done()) {
+        benchmark.printSummary();
+        bool written = benchmark.writeJSON(benchmarkOutput, meshFilename, headless ? "headless" : "windowed",
+                                           framebufferWidth, framebufferHeight);
+        std::cout << (written ? "Wrote " : "Failed to write ") << benchmarkOutput << std::endl;
     }
+
+    if (writeTrace) {
+        bool written = profiler.exportChromeTrace(traceOutput);
+        std::cout << (written ? "Wrote " : "Failed to write ") << traceOutput << std::endl;
+    }
+
+    if (headless) {
+        bool written = offscreen.writePPM(headlessOutput);
+        std::cout << (written ? "Wrote " : "Failed to write ") << headlessOutput << " after " << frameCount << " frames" << std::endl;
+    }
+
+    // Clean up explosion data
     cleanupAllExplosionData();
+    shaderReloader.stop();
 
-    // Cleanup
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-    
-    glfwTerminate();
+    // Cleanup; the headless context is released when it goes out of scope
+    if (window) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+
+        glfwTerminate();
+    }
     return 0;
 }
 
@@ -359,23 +833,21 @@ void processInput(GLFWwindow* window) {
     // Only process camera movement if mouse is captured
     if (captureMouse) {
         // Camera movement
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-            camera.ProcessKeyboard(FORWARD, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-            camera.ProcessKeyboard(BACKWARD, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-            camera.ProcessKeyboard(LEFT, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-            camera.ProcessKeyboard(RIGHT, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-            camera.ProcessKeyboard(UP, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-            camera.ProcessKeyboard(DOWN, deltaTime);
+        const int keys[] = {GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E};
+        const Camera_Movement movements[] = {FORWARD, BACKWARD, LEFT, RIGHT, UP, DOWN};
+        for (int i = 0; i < 6; i++) {
+            if (glfwGetKey(window, keys[i]) == GLFW_PRESS) {
+                camera.ProcessKeyboard(movements[i], deltaTime);
+                cameraDirty = true;
+                requestRedraw(1); // Keep drawing while the key is held
+            }
+        }
     }
 }
 
 // Process key presses
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    requestRedraw();
     if (action == GLFW_PRESS) {
         switch (key) {
             case GLFW_KEY_B:
@@ -411,24 +883,161 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
                 std::cout << "ImGui window: " << (showImGuiWindow ? "SHOWN" : "HIDDEN") << std::endl;
                 std::cout << "Mouse capture: " << (captureMouse ? "ON" : "OFF") << std::endl;
                 break;
-            case GLFW_KEY_N: // Add a key for resetting explosion
-                if (offModel) {
-                    resetExplosion(offModel);
-                    explodeFactor = 0.0f;
-                }
+            case GLFW_KEY_P:
+                showProfiler = !showProfiler;
+                break;
+            case GLFW_KEY_N: // Reset explosion
+                explodeFactor = 0.0f;
+                explodeAnimation = false;
+                explodeDirection = 1.0f;
                 std::cout << "Explosion reset" << std::endl;
                 break;
         }
     }
 }
 
+// Scripted state for --benchmark frame `frame` of `frames`: the camera makes one orbit
+// around the model while it spins and explodes out and back once. Depends only on the
+// frame index, never on elapsed time.
+void applyBenchmarkTimeline(int frame, int frames) {
+    const float pi = 3.14159265f;
+    float t = frames > 1 ? (float)frame / (frames - 1) : 0.0f;
+
+    float orbit = 2.0f * pi * t;
+    float radius = 3.0f - 1.0f * std::sin(pi * t); // Dolly in halfway through
+    camera.Position = glm::vec3(radius * std::sin(orbit), 0.75f * std::sin(2.0f * orbit), radius * std::cos(orbit));
+    glm::vec3 front = glm::normalize(-camera.Position);
+    camera.Yaw = glm::degrees(std::atan2(front.z, front.x));
+    camera.Pitch = glm::degrees(std::asin(front.y));
+    camera.updateCameraVectors();
+    cameraDirty = true;
+
+    rotationAngle = std::fmod(rotationSpeed * frame * (1.0f / 60.0f), 360.0f);
+    explodeFactor = 0.5f - 0.5f * std::cos(2.0f * pi * t);
+}
+
+// Flame graph of one recent frame, one lane per thread plus the GPU, nested zones stacked
+// downwards. The frame shown is old enough for its GPU timings to have been read back.
+void drawProfilerWindow(const GpuProfiler& gpuProfiler) {
+    ImGui::SetNextWindowSize(ImVec2(640.0f, 320.0f), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler", &showProfiler)) {
+        ImGui::End();
+        return;
+    }
+
+    // Pausing freezes the graph on the last recorded frame
+    bool recording = profiler.enabled;
+    if (ImGui::Checkbox("Record", &recording)) {
+        profiler.enabled = recording;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export Chrome Trace")) {
+        bool written = profiler.exportChromeTrace(traceOutput);
+        std::cout << (written ? "Wrote " : "Failed to write ") << traceOutput << std::endl;
+    }
+
+    int64_t frameStart = 0, frameEnd = 0;
+    if (!profiler.frameRange(GpuProfiler::FRAME_LATENCY, frameStart, frameEnd)) {
+        ImGui::Text("Waiting for frames...");
+        ImGui::End();
+        return;
+    }
+    ImGui::Text("Frame: %.2f ms CPU, %.2f ms GPU", (frameEnd - frameStart) / 1.0e6, gpuProfiler.lastFrameMs);
+
+    const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+    const float width = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+    const double pixelsPerNs = width / (double)(frameEnd - frameStart);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+
+    for (const ProfilerTrack& track : profiler.snapshot(frameStart)) {
+        int maxDepth = -1;
+        for (const ProfileEvent& event : track.events) {
+            if (event.startNs < frameEnd) maxDepth = std::max(maxDepth, event.depth);
+        }
+        if (maxDepth < 0) continue;
+
+        ImGui::TextUnformatted(track.name.c_str());
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::InvisibleButton(("##track" + std::to_string(track.id)).c_str(), ImVec2(width, (maxDepth + 1) * rowHeight));
+        bool hovered = ImGui::IsItemHovered();
+
+        for (const ProfileEvent& event : track.events) {
+            if (event.startNs >= frameEnd) continue;
+            float x0 = origin.x + (float)((std::max(event.startNs, frameStart) - frameStart) * pixelsPerNs);
+            float x1 = origin.x + (float)((std::min(event.endNs, frameEnd) - frameStart) * pixelsPerNs);
+            x1 = std::max(x1, x0 + 1.0f);
+            float y0 = origin.y + event.depth * rowHeight;
+            float y1 = y0 + rowHeight - 1.0f;
+
+            // Hue from the zone name, so a zone keeps its color from frame to frame
+            unsigned int hash = 2166136261u;
+            for (const char* c = event.name; *c; c++) hash = (hash ^ (unsigned char)*c) * 16777619u;
+            drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), ImColor::HSV((hash % 360) / 360.0f, 0.45f, 0.85f));
+            if (x1 - x0 > 24.0f) {
+                drawList->PushClipRect(ImVec2(x0, y0), ImVec2(x1, y1), true);
+                drawList->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32(0, 0, 0, 255), event.name);
+                drawList->PopClipRect();
+            }
+            if (hovered && mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1) {
+                ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.endNs - event.startNs) / 1.0e6);
+            }
+        }
+    }
+    ImGui::End();
+}
+
+// Asks the render loop for at least `frames` more frames before it may go idle
+void requestRedraw(int frames) {
+    redrawFrames = std::max(redrawFrames, frames);
+}
+
+// Whether the scene changes on its own and has to be drawn every frame
+bool sceneAnimating(const Mesh* mesh) {
+    return (autoRotate && rotationSpeed != 0.0f) || explodeAnimation ||
+           (mesh && mesh->explodeMode == EXPLODE_SIMULATED && mesh->simulation.running);
+}
+
+// Input that only ImGui consumes still has to wake the render loop
+void mouse_button_callback(GLFWwindow* /*window*/, int /*button*/, int /*action*/, int /*mods*/) {
+    requestRedraw();
+}
+
+void char_callback(GLFWwindow* /*window*/, unsigned int /*codepoint*/) {
+    requestRedraw();
+}
+
+// The window was uncovered or needs repainting for another reason
+void window_refresh_callback(GLFWwindow* /*window*/) {
+    requestRedraw(1);
+}
+
 // Callback for window resize
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    requestRedraw();
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
+    projectionDirty = true; // Froxel tiles follow the viewport
+}
+
+// Replaces the rig lights after the user lights with count small colored point lights
+// scattered around the model. The layout is seeded so it is the same on every run.
+void buildLightRig(int count) {
+    lights.resize(NUM_USER_LIGHTS, lights[0]);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < count; i++) {
+        glm::vec3 position(3.0f * unit(rng) - 1.5f, 3.0f * unit(rng) - 1.5f, 3.0f * unit(rng) - 1.5f);
+        glm::vec3 color(0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng));
+        lights.push_back(Light(position, glm::vec3(0.0f), color * 0.6f, color * 0.4f, true, 0.4f + 0.6f * unit(rng)));
+    }
+    lightsDirty = true;
 }
 
 // Callback for mouse movement
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
+    requestRedraw(); // ImGui hover state changes too
     // Skip if ImGui is using the mouse
     if (!captureMouse)
         return;
@@ -452,10 +1061,14 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 
     // Update camera angles
     camera.ProcessMouseMovement(xoffset, yoffset);
+    cameraDirty = true;
 }
 
 // Callback for scroll wheel
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
-    if (captureMouse)
+    requestRedraw();
+    if (captureMouse) {
         camera.ProcessMouseScroll(yoffset);
+        projectionDirty = true;
+    }
 }
\ No newline at end of file
@@ -5,17 +5,105 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <string>
 #include <vector>
 #include "shader.h"
 #include "OFFReader.h"
+#include "half_edge.h"
+#include "connected_parts.h"
+#include "explosion_animation.h"
+#include "fragment_simulation.h"
+#include "mesh_cache.h"
+#include "explosion_effect.h"
+#include "render_stats.h"
+#include "frustum_culling.h"
+#include "instancing.h"
 
+// Compact welded vertex shared by all faces around it
 struct MeshVertex {
     glm::vec3 position;
     glm::vec3 normal;
-    glm::vec3 faceCenter; // For explode effect
 };
 
+/**
+ * Fan-triangulates the polygons of an OffModel, assuming they are convex. Polygons with
+ * fewer than three sides add no triangles.
+ * @param indices Receives three indices into the model's vertices per triangle, appended
+ * @param polygonTriangleStart If not NULL, receives the first triangle of each polygon
+ *                             and a final end entry, counted from the start of indices
+ */
+void triangulatePolygons(const OffModel* model, std::vector<unsigned int>& indices,
+                         std::vector<int>* polygonTriangleStart = NULL) {
+    if (polygonTriangleStart) polygonTriangleStart->reserve(polygonTriangleStart->size() + model->numberOfPolygons + 1);
+    for (int i = 0; i < model->numberOfPolygons; i++) {
+        const Polygon& polygon = model->polygons[i];
+        if (polygonTriangleStart) polygonTriangleStart->push_back(indices.size() / 3);
+        for (int j = 1; j < polygon.noSides - 1; j++) {
+            indices.push_back(polygon.v[0]);
+            indices.push_back(polygon.v[j]);
+            indices.push_back(polygon.v[j + 1]);
+        }
+    }
+    if (polygonTriangleStart) polygonTriangleStart->push_back(indices.size() / 3);
+}
+
+// Unit normal of a triangle, or zero for a degenerate one
+glm::vec3 unitTriangleNormal(const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3) {
+    glm::vec3 n = glm::cross(v2 - v1, v3 - v1);
+    float len = glm::length(n);
+    return len > 0.0f ? n / len : glm::vec3(0.0f);
+}
+
+/**
+ * Sets every vertex normal to the normalized sum of the unit normals of its triangles, so
+ * each face counts the same whatever its area. Vertices without a usable normal keep the
+ * raw sum.
+ * @param vertices, vertexCount The vertices the indices refer to
+ * @param faceNormals If not NULL, receives the unit normal of each triangle
+ */
+void accumulateVertexNormals(MeshVertex* vertices, size_t vertexCount, const unsigned int* indices,
+                             size_t indexCount, std::vector<glm::vec3>* faceNormals = NULL) {
+    for (size_t i = 0; i < vertexCount; i++) {
+        vertices[i].normal = glm::vec3(0.0f);
+    }
+    if (faceNormals) faceNormals->resize(indexCount / 3);
+    for (size_t t = 0; t < indexCount / 3; t++) {
+        MeshVertex& a = vertices[indices[3 * t]];
+        MeshVertex& b = vertices[indices[3 * t + 1]];
+        MeshVertex& c = vertices[indices[3 * t + 2]];
+        glm::vec3 normal = unitTriangleNormal(a.position, b.position, c.position);
+        if (faceNormals) (*faceNormals)[t] = normal;
+        a.normal += normal;
+        b.normal += normal;
+        c.normal += normal;
+    }
+    for (size_t i = 0; i < vertexCount; i++) {
+        if (glm::length(vertices[i].normal) > 0.0001f) vertices[i].normal = glm::normalize(vertices[i].normal);
+    }
+}
+
+// Unwelded per-triangle vertex used while the explode effect is active
+struct ExplodedVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec3 explodeDirection; // Unit direction from the mesh center to the corner's polygon or part
+};
+
+// How exploded parts move; values match EXPLODE_MODE in vertex_shader.glsl
+enum ExplodeMode {
+    EXPLODE_NONE = -1,    // At rest; selects the shader variant without explode work
+    EXPLODE_DIRECT = 0,   // Straight out along the explode direction
+    EXPLODE_BAKED = 1,    // Baked per-part keyframes, multi-part meshes only
+    EXPLODE_SIMULATED = 2 // Rigid-fragment physics, multi-part meshes only
+};
+
+// Texture units of the baked keyframe and simulated transform buffers
+const int KEYFRAME_TEXTURE_UNIT = 0;
+const int FRAGMENT_TEXTURE_UNIT = 1;
+
 class Mesh {
 public:
     // Mesh data
@@ -24,11 +112,30 @@ public:
     glm::vec3 centerOfMass;
     float boundingSphereRadius;
     OffModel* offModel;
+    HalfEdgeMesh topology; // Shared connectivity of the original polygons
+    std::vector<glm::vec3> triangleNormals;   // Unit normal of each triangle in indices
+    std::vector<int> polygonTriangleStart;    // First triangle of each polygon (numPolygons + 1)
+    ConnectedParts parts;                     // Connected components of the face graph
+    std::vector<glm::vec3> partCenters;       // Vertex centroid of each part
+    std::vector<glm::vec3> partDirections;    // Unit direction from the mesh center to each part
+    std::vector<float> partRadii;             // Largest vertex distance from each part center
+    ExplosionAnimation animation;             // Baked keyframes, multi-part meshes only
+    FragmentSimulation simulation;            // Fragment physics, multi-part meshes only
+    ExplodeMode explodeMode = EXPLODE_DIRECT;
+
+    // Frustum culling splits the index buffer into meshlets of consecutive triangles, each
+    // with its own bounds; cull() picks the visible ones for the next Draw
+    static constexpr int MESHLET_TRIANGLES = 256;
+    CullStats cullStats;
+
+    // Copies placed by setInstances, drawn with one instanced draw; empty for a single copy
+    InstanceSet instances;
 
     // Constructor - loads mesh from OFF file
     Mesh(const std::string& filename) {
-        // Use OFFReader to load the mesh
-        offModel = readOffFile(const_cast<char*>(filename.c_str()));
+        PROFILE_ZONE("Mesh load");
+        // Load through the compressed cache, falling back to OFFReader
+        offModel = loadOffModel(filename);
         if (!offModel) {
             throw std::runtime_error("Failed to load OFF file: " + filename);
         }
@@ -46,36 +153,56 @@ public:
         }
         
         // Process faces and create indices
-        for (int i = 0; i < offModel->numberOfPolygons; i++) {
-            Polygon& polygon = offModel->polygons[i];
-            
-            // Triangulate polygons (assuming convex polygons)
-            for (int j = 1; j < polygon.noSides - 1; j++) {
-                indices.push_back(polygon.v[0]);
-                indices.push_back(polygon.v[j]);
-                indices.push_back(polygon.v[j + 1]);
-            }
-        }
+        triangulatePolygons(offModel, indices, &polygonTriangleStart);
         
+        topology.build(offModel);
+        vertexMark.assign(vertices.size(), 0);
+        polygonMark.assign(offModel->numberOfPolygons, 0);
+
         calculateNormals();
-        calculateFaceCenters();
         calculateCenterAndRadius();
+        buildMeshlets();
+
+        parts.build(offModel);
+        calculatePartCenters();
+        if (hasParts()) {
+            animation.bake(partCenters, partDirections, centerOfMass, boundingSphereRadius);
+            simulation.init(partCenters, partRadii, offModel->minY);
+        }
     }
     
     // Destructor - cleanup
     ~Mesh() {
+        // A pending build reads the mesh data, so let it finish first
+        if (explodedBuild.valid()) {
+            explodedBuild.wait();
+        }
+
+        cleanupExplosionData(explosionHandle);
+
         if (offModel) {
             FreeOffModel(offModel);
         }
         
-        // Clean up OpenGL resources
+        // Clean up OpenGL resources; a mesh that was never uploaded owns none and may
+        // live without a context, as in bench/normals_bench.cpp
+        if (VAO == 0) return;
         glDeleteVertexArrays(1, &VAO);
         glDeleteBuffers(1, &VBO);
         glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &partDirectionVBO);
+        glDeleteBuffers(1, &partIdVBO);
+        glDeleteBuffers(1, &keyframeBuffer);
+        glDeleteTextures(1, &keyframeTexture);
+        glDeleteBuffers(1, &transformBuffer);
+        glDeleteTextures(1, &transformTexture);
+        glDeleteVertexArrays(1, &explodedVAO);
+        glDeleteBuffers(1, &explodedVBO);
     }
 
     // Sets up the mesh data in the buffers
     void setupMesh() {
+        PROFILE_ZONE("Mesh upload");
         // Create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -98,25 +225,338 @@ public:
         // Vertex normal attribute
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
-        
-        // Face center attribute (for explosion effect)
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, faceCenter));
+
+        // Multi-part meshes explode rigidly per part, so the welded layout can carry the
+        // part direction of each vertex in a separate buffer and never needs unwelding
+        if (hasParts()) {
+            std::vector<glm::vec3> directions = vertexPartDirections();
+            glGenBuffers(1, &partDirectionVBO);
+            glBindBuffer(GL_ARRAY_BUFFER, partDirectionVBO);
+            glBufferData(GL_ARRAY_BUFFER, directions.size() * sizeof(glm::vec3), directions.data(), GL_STATIC_DRAW);
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+            // Part ids index the baked keyframes
+            std::vector<int> partIds(vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++) {
+                partIds[i] = std::max(parts.vertexPart[i], 0);
+            }
+            glGenBuffers(1, &partIdVBO);
+            glBindBuffer(GL_ARRAY_BUFFER, partIdVBO);
+            glBufferData(GL_ARRAY_BUFFER, partIds.size() * sizeof(int), partIds.data(), GL_STATIC_DRAW);
+            glEnableVertexAttribArray(3);
+            glVertexAttribIPointer(3, 1, GL_INT, sizeof(int), (void*)0);
+
+            glGenBuffers(1, &keyframeBuffer);
+            glBindBuffer(GL_TEXTURE_BUFFER, keyframeBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, animation.bytes(), animation.texels.data(), GL_STATIC_DRAW);
+            glGenTextures(1, &keyframeTexture);
+            glBindTexture(GL_TEXTURE_BUFFER, keyframeTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, keyframeBuffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+            // Simulated fragment transforms, rewritten every simulation step
+            glGenBuffers(1, &transformBuffer);
+            glBindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, simulation.size() * sizeof(glm::vec4),
+                         simulation.getTransforms().data(), GL_STREAM_DRAW);
+            glGenTextures(1, &transformTexture);
+            glBindTexture(GL_TEXTURE_BUFFER, transformTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, transformBuffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+            // Only the GPU reads the keyframes
+            keyframeBytes = animation.bytes();
+            std::vector<glm::vec4>().swap(animation.texels);
+        }
 
         // Unbind
         glBindVertexArray(0);
+
+        if (instanced()) {
+            instances.upload();
+            instances.attach(VAO);
+        }
     }
+
+    /**
+     * Draws the mesh once per transform instead of once. CPU work only, so it may run on
+     * the loader thread before setupMesh.
+     * @param transforms Placement of each copy, in the mesh's own coordinates
+     */
+    void setInstances(const std::vector<glm::mat4>& transforms) {
+        // boundingSphereRadius is half the box extent; culling needs a sphere that holds
+        // every vertex
+        float radius = 0.0f;
+        for (const MeshVertex& vertex : vertices) {
+            radius = std::max(radius, glm::length(vertex.position - centerOfMass));
+        }
+        instances.build(transforms, centerOfMass, radius);
+    }
+
+    bool instanced() const { return !instances.empty(); }
     
-    // Renders the mesh
-    void Draw(Shader &shader) {
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    // Renders the mesh. Multi-part meshes always draw the welded buffer and explode whole
+    // parts, either directly, along their baked keyframes with explodeFactor as the
+    // animation time, or with the simulated fragment transforms. Single-part meshes
+    // explode per face, drawing the welded buffer unless the unwelded stream is ready;
+    // the first exploded draw starts building that stream.
+    // The explosion itself is evaluated entirely in the vertex shader; shader must be the
+    // variant for shaderExplodeMode(explodeFactor). At rest the welded buffer is limited to
+    // the meshlets chosen by the last cull().
+    void Draw(Shader &shader, float explodeFactor = 0.0f) {
+        if (hasParts()) {
+            if (explodeMode == EXPLODE_BAKED || explodeMode == EXPLODE_SIMULATED) {
+                // Both modes take the pivot and axis from the keyframe header
+                shader.setFloat(shader.explodeTimeLocation, explodeFactor);
+                glActiveTexture(GL_TEXTURE0 + KEYFRAME_TEXTURE_UNIT);
+                glBindTexture(GL_TEXTURE_BUFFER, keyframeTexture);
+                glActiveTexture(GL_TEXTURE0 + FRAGMENT_TEXTURE_UNIT);
+                glBindTexture(GL_TEXTURE_BUFFER, transformTexture);
+                glActiveTexture(GL_TEXTURE0);
+            } else {
+                shader.setFloat(shader.explodeDistanceLocation, explodeFactor * boundingSphereRadius);
+            }
+            glBindVertexArray(VAO);
+            drawWelded();
+            glBindVertexArray(0);
+            return;
+        }
+
+        if (explodeFactor > 0.0f) {
+            requestExplodedStream();
+        }
+        pollExplodedStream();
+
+        if (explodeFactor > 0.0f && explodedVertexCount > 0) {
+            shader.setFloat(shader.explodeDistanceLocation, explodeFactor * boundingSphereRadius);
+            glBindVertexArray(explodedVAO);
+            if (instanced()) {
+                glDrawArraysInstanced(GL_TRIANGLES, 0, explodedVertexCount, instances.drawCount());
+                renderStats.addDraw((long long)explodedVertexCount / 3 * instances.drawCount());
+            } else {
+                glDrawArrays(GL_TRIANGLES, 0, explodedVertexCount);
+                renderStats.addDraw(explodedVertexCount / 3);
+            }
+        } else {
+            shader.setFloat(shader.explodeDistanceLocation, 0.0f);
+            glBindVertexArray(VAO);
+            drawWelded();
+        }
+        glBindVertexArray(0);
+    }
+
+    /**
+     * Picks the meshlets the next Draw submits, or for an instanced mesh the copies. Bounds
+     * hold for the mesh at rest only, so an exploding mesh is drawn whole.
+     * @param frustum Frustum in model space (from projection * view * model), or NULL to
+     *                draw every meshlet
+     */
+    void cull(const Frustum* frustum, float explodeFactor) {
+        cullStats = CullStats();
+        bool atRest = shaderExplodeMode(explodeFactor) == EXPLODE_NONE;
+        if (instanced()) {
+            // Copies are culled whole; each one draws every meshlet
+            culling = false;
+            instances.cull(frustum && atRest ? frustum : NULL, cullStats);
+            return;
+        }
+        culling = frustum != NULL && atRest;
+        if (!culling) return;
+        if (meshletsStale) buildMeshlets();
+
+        visibleMeshlets.clear();
+        meshletBVH.cull(*frustum, visibleMeshlets, cullStats);
+
+        // In index order, neighbouring visible meshlets merge into one range
+        std::sort(visibleMeshlets.begin(), visibleMeshlets.end());
+        drawCounts.clear();
+        drawOffsets.clear();
+        size_t rangeEnd = 0;
+        for (int meshlet : visibleMeshlets) {
+            size_t first = (size_t)meshlet * MESHLET_TRIANGLES * 3;
+            GLsizei count = (GLsizei)(std::min(first + MESHLET_TRIANGLES * 3, indices.size()) - first);
+            if (!drawCounts.empty() && first == rangeEnd) {
+                drawCounts.back() += count;
+            } else {
+                drawCounts.push_back(count);
+                drawOffsets.push_back((const void*)(first * sizeof(unsigned int)));
+            }
+            rangeEnd = first + count;
+        }
+    }
+
+    int meshletCount() const { return (int)meshletBVH.size(); }
+
+    // Explode path the vertex shader needs to draw this frame. Simulated fragments may rest
+    // away from their original place, so they keep their variant at any explode factor.
+    ExplodeMode shaderExplodeMode(float explodeFactor) const {
+        if (hasParts() && explodeMode == EXPLODE_SIMULATED) return EXPLODE_SIMULATED;
+        if (explodeFactor <= 0.0f) return EXPLODE_NONE;
+        return hasParts() ? explodeMode : EXPLODE_DIRECT;
+    }
+
+    // Starts building the unwelded stream on a worker thread if it does not exist yet
+    void requestExplodedStream() {
+        if (explodedVertexCount > 0 || explodedBuild.valid()) return;
+        explodedBuild = std::async(std::launch::async, [this]() { return buildExplodedStream(); });
+    }
+
+    // Uploads the unwelded stream once the worker has finished
+    void pollExplodedStream() {
+        if (!explodedBuild.valid() ||
+            explodedBuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        std::vector<ExplodedVertex> stream = explodedBuild.get();
+
+        if (explodedVAO == 0) {
+            glGenVertexArrays(1, &explodedVAO);
+            glGenBuffers(1, &explodedVBO);
+        }
+        glBindVertexArray(explodedVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, explodedVBO);
+        glBufferData(GL_ARRAY_BUFFER, stream.size() * sizeof(ExplodedVertex), stream.data(), GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ExplodedVertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ExplodedVertex), (void*)offsetof(ExplodedVertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ExplodedVertex), (void*)offsetof(ExplodedVertex, explodeDirection));
         glBindVertexArray(0);
+        if (instanced()) instances.attach(explodedVAO);
+
+        explodedVertexCount = stream.size();
+    }
+
+    // Drops the unwelded stream so it is rebuilt from the current vertices on next use
+    void invalidateExplodedStream() {
+        if (explodedBuild.valid()) {
+            explodedBuild.wait();
+            explodedBuild.get();
+        }
+        explodedVertexCount = 0;
+        cleanupExplosionData(explosionHandle);
+        explodedPositionsFactor = -1.0f;
+    }
+
+    /**
+     * Exploded corner positions, one per index in the mesh's own coordinates, placed the way
+     * the vertex shader places them for shaderExplodeMode(explodeFactor). Evaluated on the
+     * CPU only when requested; the Direct result is cached until the factor changes.
+     */
+    const ExplodedPositions& getExplodedPositions(float explodeFactor) {
+        ExplodeMode mode = shaderExplodeMode(explodeFactor);
+        if (mode == EXPLODE_BAKED || mode == EXPLODE_SIMULATED) {
+            evaluateRigidExplosion(mode, explodeFactor);
+            return explodedPositions;
+        }
+
+        if (!explosionRegistry.isAlive(explosionHandle)) {
+            ExplosionState state;
+            state.centroid = centerOfMass;
+            state.resize(indices.size());
+            forEachExplodedCorner([&](size_t i, const MeshVertex& vertex, const glm::vec3& direction) {
+                state.set(i, vertex.position, direction);
+            });
+            explosionHandle = explosionRegistry.create(std::move(state));
+            explodedPositions.resize(indices.size());
+            explodedPositionsFactor = -1.0f;
+        }
+        if (explodeFactor != explodedPositionsFactor) {
+            updateExplosion(explosionHandle, explodeFactor * boundingSphereRadius,
+                            explodedPositions.x.data(), explodedPositions.y.data(), explodedPositions.z.data());
+            explodedPositionsFactor = explodeFactor;
+        }
+        return explodedPositions;
+    }
+
+    // Writes the exploded geometry as a triangle soup OFF file, one soup per instance
+    bool exportExploded(const std::string& path, float explodeFactor) {
+        const ExplodedPositions& positions = getExplodedPositions(explodeFactor);
+        FILE* output = fopen(path.c_str(), "w");
+        if (!output) return false;
+
+        size_t copies = instanced() ? instances.size() : 1;
+        size_t count = positions.size() * copies;
+        fprintf(output, "OFF\n%zu %zu 0\n", count, count / 3);
+        for (size_t c = 0; c < copies; c++) {
+            glm::mat4 transform = instanced() ? instances.transform(c) : glm::mat4(1.0f);
+            for (size_t i = 0; i < positions.size(); i++) {
+                glm::vec3 p = glm::vec3(transform * glm::vec4(positions.x[i], positions.y[i], positions.z[i], 1.0f));
+                fprintf(output, "%f %f %f\n", p.x, p.y, p.z);
+            }
+        }
+        for (size_t i = 0; i < count; i += 3) {
+            fprintf(output, "3 %zu %zu %zu\n", i, i + 1, i + 2);
+        }
+        return fclose(output) == 0;
+    }
+
+    bool isExplodedStreamBuilding() const { return explodedBuild.valid(); }
+
+    // True when the mesh has several connected parts and explodes them rigidly
+    bool hasParts() const { return parts.numParts > 1; }
+
+    // GPU memory used by the welded layout (vertex, index and part attribute buffers)
+    size_t weldedBytes() const {
+        return vertices.size() * (sizeof(MeshVertex) + (hasParts() ? sizeof(glm::vec3) + sizeof(int) : 0)) +
+               indices.size() * sizeof(unsigned int);
+    }
+
+    // Throws the fragments outwards from their rest pose
+    void launchSimulation() {
+        if (!hasParts()) return;
+        simulation.launch(partDirections, boundingSphereRadius);
+        uploadFragmentTransforms();
+    }
+
+    // Puts the fragments back in their rest pose
+    void resetSimulation() {
+        if (!hasParts()) return;
+        simulation.reset();
+        uploadFragmentTransforms();
+    }
+
+    // Steps the fragment simulation while it is the active explode mode and uploads the
+    // transforms in a single glBufferSubData
+    void updateSimulation(float deltaTime) {
+        if (explodeMode != EXPLODE_SIMULATED || !simulation.running) return;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        simulation.step(deltaTime);
+        auto end = std::chrono::high_resolution_clock::now();
+        simulationMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+        uploadFragmentTransforms();
+    }
+
+    // CPU time of the last simulation step
+    float getSimulationMs() const { return simulationMs; }
+
+    // GPU memory used by the baked keyframe buffer
+    size_t animationBytes() const {
+        return keyframeBytes;
+    }
+
+    // GPU memory used by the unwelded stream, or zero if it has not been built
+    size_t explodedBytes() const {
+        return explodedVertexCount * sizeof(ExplodedVertex);
     }
     
     // Get model matrix that centers and scales the mesh to fit view
     glm::mat4 getModelMatrix(float rotationAngle, glm::vec3 rotationAxis) {
         glm::mat4 model = glm::mat4(1.0f);
+
+        // Instances span their own box, which is scaled to fit and spun about its center
+        if (instanced()) {
+            model = glm::scale(model, glm::vec3(1.0f / instances.radius));
+            model = glm::rotate(model, glm::radians(rotationAngle), rotationAxis);
+            return glm::translate(model, -instances.center);
+        }
         
         // Center the mesh
         model = glm::translate(model, -centerOfMass);
@@ -130,15 +570,88 @@ public:
         
         return model;
     }
-    // Add this method to your Mesh class definition
+
+    // Matrix that transforms normals under model: the inverse transpose of its upper 3x3.
+    // Computed once per draw so the vertex shader does not invert a matrix per vertex.
+    static glm::mat3 getNormalMatrix(const glm::mat4& model) {
+        return glm::transpose(glm::inverse(glm::mat3(model)));
+    }
+    // Re-uploads the whole vertex buffer
     void updateBuffers() {
-        glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    
-        // Update only the position data in the buffer
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_DYNAMIC_DRAW);
-    
-        glBindVertexArray(0);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(MeshVertex), &vertices[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        dirtyVertices.clear();
+        std::fill(vertexMark.begin(), vertexMark.end(), 0);
+        meshletsStale = true;
+    }
+
+    // Moves a vertex and marks it for the next commitVertexEdits
+    void setVertexPosition(unsigned int index, const glm::vec3& position) {
+        vertices[index].position = position;
+        offModel->vertices[index].x = position.x;
+        offModel->vertices[index].y = position.y;
+        offModel->vertices[index].z = position.z;
+        markVertexDirty(index);
+    }
+
+    // Marks a vertex whose position was changed directly in vertices
+    void markVertexDirty(unsigned int index) {
+        if (vertexMark[index] == 0) {
+            vertexMark[index] = DIRTY_VERTEX;
+            dirtyVertices.push_back(index);
+        }
+    }
+
+    // Recomputes normals only for faces touching dirty vertices and for their one-ring
+    // vertices, then uploads the modified vertex ranges with glBufferSubData.
+    // Cost is proportional to the size of the edit, not the mesh, except that the exploded
+    // stream is dropped and multi-part meshes recompute their part data in full.
+    void commitVertexEdits() {
+        if (dirtyVertices.empty()) return;
+        PROFILE_ZONE("Commit vertex edits");
+        invalidateExplodedStream();
+
+        // Faces touching a moved vertex
+        touchedPolygons.clear();
+        for (unsigned int v : dirtyVertices) {
+            topology.forEachVertexFace(v, [&](int f) {
+                if (!polygonMark[f]) {
+                    polygonMark[f] = 1;
+                    touchedPolygons.push_back(f);
+                }
+            });
+        }
+
+        // Refresh their triangle normals and collect every vertex whose normal they feed
+        touchedVertices.assign(dirtyVertices.begin(), dirtyVertices.end());
+        for (int f : touchedPolygons) {
+            for (int t = polygonTriangleStart[f]; t < polygonTriangleStart[f + 1]; t++) {
+                triangleNormals[t] = triangleNormal(t);
+            }
+            const Polygon& polygon = offModel->polygons[f];
+            for (int j = 0; j < polygon.noSides; j++) {
+                unsigned int v = polygon.v[j];
+                if (vertexMark[v] == 0) {
+                    vertexMark[v] = AFFECTED_VERTEX;
+                    touchedVertices.push_back(v);
+                }
+            }
+        }
+
+        for (unsigned int v : touchedVertices) {
+            updateVertexNormal(v);
+        }
+
+        uploadVertexRanges(touchedVertices);
+        meshletsStale = true;
+        if (hasParts()) refreshParts();
+
+        // Reset marks for the next edit
+        for (int f : touchedPolygons) polygonMark[f] = 0;
+        for (unsigned int v : touchedVertices) vertexMark[v] = 0;
+        dirtyVertices.clear();
     }
 
     // Get underlying OffModel for explosion effects
@@ -149,68 +662,231 @@ public:
 private:
     // Render data
     unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int partDirectionVBO = 0; // Per-vertex part direction, multi-part meshes only
+    unsigned int partIdVBO = 0;        // Per-vertex part id, multi-part meshes only
+    unsigned int keyframeBuffer = 0, keyframeTexture = 0; // Baked animation texture buffer
+    size_t keyframeBytes = 0;
+    unsigned int transformBuffer = 0, transformTexture = 0; // Simulated fragment transforms
+    float simulationMs = 0.0f;
 
-    // Calculate vertex normals
-    void calculateNormals() {
-        // Initialize all normals to zero
-        for (auto& vertex : vertices) {
-            vertex.normal = glm::vec3(0.0f);
+    // Unwelded stream for the explode effect, built lazily
+    unsigned int explodedVAO = 0, explodedVBO = 0;
+    size_t explodedVertexCount = 0;
+    std::future<std::vector<ExplodedVertex>> explodedBuild;
+
+    // Meshlet culling state; ranges are byte offsets into the index buffer
+    CullingBVH meshletBVH;
+    bool meshletsStale = true;
+    bool culling = false;
+    std::vector<int> visibleMeshlets;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+
+    // CPU-evaluated exploded positions, filled on request only
+    ExplosionHandle explosionHandle;
+    ExplodedPositions explodedPositions;
+    float explodedPositionsFactor = -1.0f;
+
+    // Dirty tracking for incremental updates
+    static const unsigned char DIRTY_VERTEX = 1;
+    static const unsigned char AFFECTED_VERTEX = 2;
+    std::vector<unsigned char> vertexMark;    // Per-vertex edit state
+    std::vector<unsigned char> polygonMark;   // Per-polygon visited flag
+    std::vector<unsigned int> dirtyVertices;  // Vertices moved since the last commit
+    std::vector<unsigned int> touchedVertices;
+    std::vector<int> touchedPolygons;
+
+    // Bounds of every MESHLET_TRIANGLES-triangle range of the index buffer, in model space
+    void buildMeshlets() {
+        PROFILE_ZONE("Build meshlets");
+        size_t triangles = indices.size() / 3;
+        std::vector<CullBounds> bounds((triangles + MESHLET_TRIANGLES - 1) / MESHLET_TRIANGLES);
+        for (size_t m = 0; m < bounds.size(); m++) {
+            size_t first = m * MESHLET_TRIANGLES * 3;
+            size_t end = std::min(first + MESHLET_TRIANGLES * 3, indices.size());
+            glm::vec3 min(INFINITY), max(-INFINITY);
+            for (size_t i = first; i < end; i++) {
+                min = glm::min(min, vertices[indices[i]].position);
+                max = glm::max(max, vertices[indices[i]].position);
+            }
+            glm::vec3 center = (min + max) * 0.5f;
+            float radius = 0.0f;
+            for (size_t i = first; i < end; i++) {
+                radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+            }
+            bounds[m] = {min, max, center, radius};
         }
-        
-        // For each face (triangle), calculate normal and add to connected vertices
-        for (size_t i = 0; i < indices.size(); i += 3) {
-            unsigned int idx1 = indices[i];
-            unsigned int idx2 = indices[i+1];
-            unsigned int idx3 = indices[i+2];
-            
-            glm::vec3 v1 = vertices[idx1].position;
-            glm::vec3 v2 = vertices[idx2].position;
-            glm::vec3 v3 = vertices[idx3].position;
-            
-            // Calculate face normal using cross product
-            glm::vec3 edge1 = v2 - v1;
-            glm::vec3 edge2 = v3 - v1;
-            glm::vec3 faceNormal = glm::normalize(glm::cross(edge1, edge2));
-            
-            // Add face normal to all vertices of this face
-            vertices[idx1].normal += faceNormal;
-            vertices[idx2].normal += faceNormal;
-            vertices[idx3].normal += faceNormal;
-            
-            // Update the OffModel normals too (for potential reuse)
-            offModel->vertices[idx1].numIcidentTri++;
-            offModel->vertices[idx2].numIcidentTri++;
-            offModel->vertices[idx3].numIcidentTri++;
+        meshletBVH.build(bounds);
+        meshletsStale = false;
+    }
+
+    // Draws the welded index buffer, only the visible ranges after a cull, or once per
+    // visible copy of an instanced mesh
+    void drawWelded() {
+        if (instanced()) {
+            GLsizei copies = instances.drawCount();
+            if (copies == 0) return;
+            glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, copies);
+            renderStats.addDraw((long long)indices.size() / 3 * copies);
+            return;
         }
-        
-        // Normalize all vertex normals
+        if (!culling) {
+            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+            renderStats.addDraw(indices.size() / 3);
+            return;
+        }
+        if (drawCounts.empty()) return;
+        glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), (GLsizei)drawCounts.size());
+        long long triangles = 0;
+        for (GLsizei count : drawCounts) triangles += count / 3;
+        renderStats.addDraw(triangles);
+    }
+
+    void uploadFragmentTransforms() {
+        if (transformBuffer == 0) return;
+        const std::vector<glm::vec4>& transforms = simulation.getTransforms();
+        glBindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, transforms.size() * sizeof(glm::vec4), transforms.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Unit normal of triangle t, or zero for degenerate triangles
+    glm::vec3 triangleNormal(size_t t) const {
+        return unitTriangleNormal(vertices[indices[3 * t]].position, vertices[indices[3 * t + 1]].position,
+                                  vertices[indices[3 * t + 2]].position);
+    }
+
+    // Rebuilds one vertex normal from the cached normals of its incident triangles
+    void updateVertexNormal(unsigned int v) {
+        glm::vec3 normal(0.0f);
+        topology.forEachVertexFace(v, [&](int f) {
+            for (int t = polygonTriangleStart[f]; t < polygonTriangleStart[f + 1]; t++) {
+                if (indices[3 * t] == v || indices[3 * t + 1] == v || indices[3 * t + 2] == v) {
+                    normal += triangleNormals[t];
+                }
+            }
+        });
+
+        if (glm::length(normal) > 0.0001f) {
+            normal = glm::normalize(normal);
+            offModel->vertices[v].normal.x = normal.x;
+            offModel->vertices[v].normal.y = normal.y;
+            offModel->vertices[v].normal.z = normal.z;
+        }
+        vertices[v].normal = normal;
+    }
+
+    // Uploads sorted runs of modified vertices, merging runs separated by small gaps
+    void uploadVertexRanges(std::vector<unsigned int>& modified) {
+        if (VBO == 0 || modified.empty()) return;
+        const unsigned int maxGap = 16;
+
+        std::sort(modified.begin(), modified.end());
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        size_t runStart = 0;
+        for (size_t i = 1; i <= modified.size(); i++) {
+            if (i < modified.size() && modified[i] - modified[i - 1] <= maxGap) continue;
+
+            unsigned int first = modified[runStart];
+            unsigned int count = modified[i - 1] - first + 1;
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(MeshVertex), count * sizeof(MeshVertex), &vertices[first]);
+            runStart = i;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Calculate vertex normals
+    void calculateNormals() {
+        PROFILE_ZONE("Vertex normals");
+        accumulateVertexNormals(vertices.data(), vertices.size(), indices.data(), indices.size(), &triangleNormals);
         for (size_t i = 0; i < vertices.size(); i++) {
+            // Update the OffModel normals too (for potential reuse)
             if (glm::length(vertices[i].normal) > 0.0001f) {
-                vertices[i].normal = glm::normalize(vertices[i].normal);
-                
-                // Update the OffModel normals too
                 offModel->vertices[i].normal.x = vertices[i].normal.x;
                 offModel->vertices[i].normal.y = vertices[i].normal.y;
                 offModel->vertices[i].normal.z = vertices[i].normal.z;
             }
         }
+        for (unsigned int index : indices) {
+            offModel->vertices[index].numIcidentTri++;
+        }
     }
+
     
-    // Calculate face centers for explosion effect
-    void calculateFaceCenters() {
-        // For each triangle
-        for (size_t i = 0; i < indices.size(); i += 3) {
-            unsigned int idx1 = indices[i];
-            unsigned int idx2 = indices[i+1];
-            unsigned int idx3 = indices[i+2];
-            
-            glm::vec3 center = (vertices[idx1].position + vertices[idx2].position + vertices[idx3].position) / 3.0f;
-            
-            // Store face center for each vertex of this triangle
-            vertices[idx1].faceCenter = center;
-            vertices[idx2].faceCenter = center;
-            vertices[idx3].faceCenter = center;
+    // Places every corner with its part's pivot, axis and key for a rigid explode mode,
+    // mirroring the EXPLODE_MODE > 0 path of vertex_shader.glsl
+    void evaluateRigidExplosion(ExplodeMode mode, float explodeFactor) {
+        PROFILE_ZONE("Evaluate rigid explosion");
+        // After setupMesh the keyframes only live on the GPU; baking is deterministic, so
+        // a fresh bake reproduces them
+        ExplosionAnimation baked;
+        const ExplosionAnimation* keyframes = &animation;
+        if (animation.texels.empty()) {
+            baked = animation;
+            baked.bake(partCenters, partDirections, centerOfMass, boundingSphereRadius);
+            keyframes = &baked;
         }
+        const std::vector<glm::vec4>& transforms = simulation.getTransforms();
+
+        explodedPositions.resize(indices.size());
+        explodedPositionsFactor = -1.0f;
+        parallelFor(0, (int)indices.size(), [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                int part = std::max(parts.vertexPart[indices[i]], 0);
+                glm::vec3 pivot = keyframes->pivot(part);
+                glm::vec4 key = mode == EXPLODE_BAKED ? keyframes->key(part, explodeFactor) : transforms[part];
+                glm::vec3 p = pivot + rotateAxisAngle(vertices[indices[i]].position - pivot, keyframes->axis(part), key.w) +
+                              glm::vec3(key);
+                explodedPositions.x[i] = p.x;
+                explodedPositions.y[i] = p.y;
+                explodedPositions.z[i] = p.z;
+            }
+        });
+    }
+
+    // Calls fn(corner, vertex, direction) for every unwelded triangle corner, where
+    // direction points from the mesh center to the corner's part, or to the center of
+    // the corner's polygon when the mesh is a single part
+    template <typename Fn>
+    void forEachExplodedCorner(Fn fn) const {
+        if (hasParts()) {
+            for (size_t i = 0; i < indices.size(); i++) {
+                fn(i, vertices[indices[i]], partDirections[parts.vertexPart[indices[i]]]);
+            }
+            return;
+        }
+
+        int numPolygons = (int)polygonTriangleStart.size() - 1;
+
+        for (int f = 0; f < numPolygons; f++) {
+            const Polygon& polygon = offModel->polygons[f];
+            glm::vec3 center(0.0f);
+            for (int j = 0; j < polygon.noSides; j++) {
+                center += vertices[polygon.v[j]].position;
+            }
+            center /= (float)std::max(polygon.noSides, 1);
+
+            glm::vec3 direction = center - centerOfMass;
+            float distance = glm::length(direction);
+            direction = distance > 0.0001f ? direction / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+
+            for (size_t i = 3 * polygonTriangleStart[f]; i < 3 * (size_t)polygonTriangleStart[f + 1]; i++) {
+                fn(i, vertices[indices[i]], direction);
+            }
+        }
+    }
+
+    // Builds one vertex per triangle corner with its precomputed explode direction.
+    // Runs on a worker thread and only reads mesh data.
+    std::vector<ExplodedVertex> buildExplodedStream() const {
+        PROFILE_ZONE("Build explode stream");
+        std::vector<ExplodedVertex> stream(indices.size());
+        forEachExplodedCorner([&](size_t i, const MeshVertex& vertex, const glm::vec3& direction) {
+            stream[i].position = vertex.position;
+            stream[i].normal = vertex.normal;
+            stream[i].explodeDirection = direction;
+        });
+        return stream;
     }
     
     // Calculate center of mass and bounding sphere radius
@@ -225,18 +901,67 @@ private:
         // boundingSphereRadius is half the extent
         boundingSphereRadius = offModel->extent / 2.0f;
     }
-};
 
-// Light structure
-struct Light {
-    glm::vec3 position;
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-    bool enabled;
-    
-    Light(glm::vec3 position, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, bool enabled) 
-        : position(position), ambient(ambient), diffuse(diffuse), specular(specular), enabled(enabled) {}
+    // Part direction of every vertex, zero for vertices outside any part
+    std::vector<glm::vec3> vertexPartDirections() const {
+        std::vector<glm::vec3> directions(vertices.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i < vertices.size(); i++) {
+            int part = parts.vertexPart[i];
+            if (part >= 0) directions[i] = partDirections[part];
+        }
+        return directions;
+    }
+
+    // Brings everything derived from part positions up to date after vertex edits: part
+    // centers, directions and radii, the direction buffer, the baked keyframes and the
+    // simulation's rest heights. A running simulation restarts from rest.
+    void refreshParts() {
+        PROFILE_ZONE("Refresh parts");
+        calculatePartCenters();
+        animation.bake(partCenters, partDirections, centerOfMass, boundingSphereRadius);
+        simulation.init(partCenters, partRadii, offModel->minY);
+        if (partDirectionVBO == 0) return;
+
+        std::vector<glm::vec3> directions = vertexPartDirections();
+        glBindBuffer(GL_ARRAY_BUFFER, partDirectionVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, directions.size() * sizeof(glm::vec3), directions.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // The part count is unchanged, so the keyframes fit the existing buffer
+        glBindBuffer(GL_TEXTURE_BUFFER, keyframeBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, animation.bytes(), animation.texels.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        std::vector<glm::vec4>().swap(animation.texels);
+        uploadFragmentTransforms();
+    }
+
+    // Averages the vertices of each part and derives its explode direction and radius.
+    // Recomputed by refreshParts after vertex edits.
+    void calculatePartCenters() {
+        partCenters.assign(parts.numParts, glm::vec3(0.0f));
+        std::vector<int> partVertexCount(parts.numParts, 0);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            int part = parts.vertexPart[i];
+            if (part < 0) continue;
+            partCenters[part] += vertices[i].position;
+            partVertexCount[part]++;
+        }
+
+        partDirections.resize(parts.numParts);
+        for (int p = 0; p < parts.numParts; p++) {
+            partCenters[p] /= (float)partVertexCount[p];
+            glm::vec3 direction = partCenters[p] - centerOfMass;
+            float distance = glm::length(direction);
+            partDirections[p] = distance > 0.0001f ? direction / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+
+        partRadii.assign(parts.numParts, 0.0f);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            int part = parts.vertexPart[i];
+            if (part < 0) continue;
+            partRadii[part] = std::max(partRadii[part], glm::length(vertices[i].position - partCenters[part]));
+        }
+    }
 };
 
 #endif // MESH_H
\ No newline at end of file
@@ -0,0 +1,225 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "OFFReader.h"
+#include "mesh_codec.h"
+#include "profiler.h"
+
+// Compressed binary cache written next to each OFF file (<file>.off.meshc).
+//
+// Layout (little endian u32 unless noted):
+//   magic, version, source size (u64), source mtime (u64),
+//   vertices, polygons, triangles, position bytes, index bytes,
+//   polygon side counts (one byte each), encoded positions, encoded fan triangles.
+// Polygons are recovered from their fan triangulation, so faces with fewer than three
+// sides are not cacheable and such models always load from the OFF file.
+
+const uint32_t MESH_CACHE_MAGIC = 0x4348534d; // "MSHC"
+const uint32_t MESH_CACHE_VERSION = 1;
+const size_t MESH_CACHE_HEADER_SIZE = 44;
+
+std::string meshCachePath(const std::string& offPath) {
+    return offPath + ".meshc";
+}
+
+// Size and modification time of the source file, used to detect stale caches
+bool meshSourceStamp(const std::string& path, uint64_t& size, uint64_t& time) {
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    time = (uint64_t)mtime.time_since_epoch().count();
+    return true;
+}
+
+/**
+ * Writes the compressed cache for a model. Failures are not fatal; the model simply
+ * keeps loading from the OFF file.
+ * @return true if the cache was written
+ */
+bool writeMeshCache(const std::string& offPath, const OffModel* model) {
+    uint64_t sourceSize, sourceTime;
+    if (!model || !meshSourceStamp(offPath, sourceSize, sourceTime)) return false;
+
+    std::vector<unsigned char> sides(model->numberOfPolygons);
+    std::vector<unsigned int> triangles;
+    for (int i = 0; i < model->numberOfPolygons; i++) {
+        const Polygon& polygon = model->polygons[i];
+        if (polygon.noSides < 3 || polygon.noSides > 255) return false;
+        sides[i] = (unsigned char)polygon.noSides;
+        for (int j = 1; j < polygon.noSides - 1; j++) {
+            triangles.push_back(polygon.v[0]);
+            triangles.push_back(polygon.v[j]);
+            triangles.push_back(polygon.v[j + 1]);
+        }
+    }
+
+    std::vector<uint32_t> positions(model->numberOfVertices * 3);
+    for (int i = 0; i < model->numberOfVertices; i++) {
+        memcpy(&positions[3 * i], &model->vertices[i].x, 3 * sizeof(float));
+    }
+
+    std::vector<unsigned char> vertexData = encodeVertexStream(positions.data(), model->numberOfVertices, 3);
+    std::vector<unsigned char> indexData = encodeIndexBuffer(triangles.data(), triangles.size());
+
+    std::vector<unsigned char> header;
+    codecPutU32(header, MESH_CACHE_MAGIC);
+    codecPutU32(header, MESH_CACHE_VERSION);
+    codecPutU32(header, (uint32_t)sourceSize);
+    codecPutU32(header, (uint32_t)(sourceSize >> 32));
+    codecPutU32(header, (uint32_t)sourceTime);
+    codecPutU32(header, (uint32_t)(sourceTime >> 32));
+    codecPutU32(header, model->numberOfVertices);
+    codecPutU32(header, model->numberOfPolygons);
+    codecPutU32(header, triangles.size() / 3);
+    codecPutU32(header, vertexData.size());
+    codecPutU32(header, indexData.size());
+
+    // Write to a temporary file first so a crash never leaves a truncated cache behind
+    std::string cachePath = meshCachePath(offPath);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary);
+        if (!out) return false;
+        out.write((const char*)header.data(), header.size());
+        out.write((const char*)sides.data(), sides.size());
+        out.write((const char*)vertexData.data(), vertexData.size());
+        out.write((const char*)indexData.data(), indexData.size());
+        if (!out) {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    return !ec;
+}
+
+/**
+ * Loads a model from its compressed cache if the cache exists and matches the OFF file.
+ * @return Pointer to the constructed OffModel, or NULL if the cache is missing or stale
+ */
+OffModel* readMeshCache(const std::string& offPath) {
+    uint64_t sourceSize, sourceTime;
+    if (!meshSourceStamp(offPath, sourceSize, sourceTime)) return NULL;
+
+    std::ifstream in(meshCachePath(offPath), std::ios::binary | std::ios::ate);
+    if (!in) return NULL;
+    std::vector<unsigned char> file((size_t)in.tellg());
+    in.seekg(0);
+    if (file.size() < MESH_CACHE_HEADER_SIZE || !in.read((char*)file.data(), file.size())) return NULL;
+
+    const unsigned char* h = file.data();
+    uint64_t cachedSize = codecGetU32(h + 8) | ((uint64_t)codecGetU32(h + 12) << 32);
+    uint64_t cachedTime = codecGetU32(h + 16) | ((uint64_t)codecGetU32(h + 20) << 32);
+    if (codecGetU32(h) != MESH_CACHE_MAGIC || codecGetU32(h + 4) != MESH_CACHE_VERSION ||
+        cachedSize != sourceSize || cachedTime != sourceTime) {
+        return NULL;
+    }
+
+    size_t nv = codecGetU32(h + 24);
+    size_t np = codecGetU32(h + 28);
+    size_t nt = codecGetU32(h + 32);
+    size_t vertexBytes = codecGetU32(h + 36);
+    size_t indexBytes = codecGetU32(h + 40);
+    if (nv == 0 || np == 0 || MESH_CACHE_HEADER_SIZE + np + vertexBytes + indexBytes != file.size()) return NULL;
+
+    const unsigned char* sides = h + MESH_CACHE_HEADER_SIZE;
+    const unsigned char* vertexData = sides + np;
+    const unsigned char* indexData = vertexData + vertexBytes;
+
+    std::vector<uint32_t> positions(nv * 3);
+    std::vector<unsigned int> triangles(nt * 3);
+    if (!decodeVertexStream(positions.data(), nv, 3, vertexData, vertexBytes) ||
+        !decodeIndexBuffer(triangles.data(), triangles.size(), indexData, indexBytes)) {
+        return NULL;
+    }
+
+    // Rebuild the OffModel exactly as readOffFile lays it out
+    OffModel* model = (OffModel*)malloc(sizeof(OffModel));
+    if (!model) return NULL;
+    model->numberOfVertices = (int)nv;
+    model->numberOfPolygons = (int)np;
+    model->vertices = (Vertex*)malloc(nv * sizeof(Vertex));
+    model->polygons = (Polygon*)calloc(np, sizeof(Polygon));
+    if (!model->vertices || !model->polygons) {
+        FreeOffModel(model);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < nv; i++) {
+        memcpy(&model->vertices[i].x, &positions[3 * i], 3 * sizeof(float));
+        model->vertices[i].normal.x = 0.0f;
+        model->vertices[i].normal.y = 0.0f;
+        model->vertices[i].normal.z = 0.0f;
+        model->vertices[i].numIcidentTri = 0;
+    }
+
+    // Polygon i is the fan (v0, vj, vj+1); its corners are the first triangle plus the
+    // last corner of every following triangle
+    size_t t = 0;
+    for (size_t i = 0; i < np; i++) {
+        int n = sides[i];
+        if (n < 3 || t + (n - 2) > nt) {
+            FreeOffModel(model);
+            return NULL;
+        }
+        model->polygons[i].noSides = n;
+        model->polygons[i].v = (int*)malloc(n * sizeof(int));
+        if (!model->polygons[i].v) {
+            FreeOffModel(model);
+            return NULL;
+        }
+        model->polygons[i].v[0] = triangles[3 * t];
+        model->polygons[i].v[1] = triangles[3 * t + 1];
+        for (int j = 2; j < n; j++, t++) {
+            model->polygons[i].v[j] = triangles[3 * t + 2];
+        }
+        for (int j = 0; j < n; j++) {
+            if (model->polygons[i].v[j] < 0 || model->polygons[i].v[j] >= (int)nv) {
+                FreeOffModel(model);
+                return NULL;
+            }
+        }
+    }
+    if (t != nt) {
+        FreeOffModel(model);
+        return NULL;
+    }
+
+    computeBoundingBox(model);
+    return model;
+}
+
+/**
+ * Loads a model through its compressed cache, parsing the OFF file and refreshing the
+ * cache when the cache is missing or out of date.
+ * @return Pointer to the constructed OffModel, or NULL on failure
+ */
+OffModel* loadOffModel(const std::string& offPath) {
+    PROFILE_ZONE("Load OFF model");
+    OffModel* model = readMeshCache(offPath);
+    if (model) {
+        std::cout << "Loaded mesh cache: " << meshCachePath(offPath) << std::endl;
+        return model;
+    }
+
+    model = readOffFile(const_cast<char*>(offPath.c_str()));
+    if (model && !writeMeshCache(offPath, model)) {
+        std::cout << "Mesh cache not written for " << offPath << std::endl;
+    }
+    return model;
+}
+
+#endif // MESH_CACHE_H
@@ -0,0 +1,324 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Lossless codecs for triangle index buffers and vertex attribute streams.
+//
+// Index buffers use edge/vertex FIFO prediction: most triangles share an edge with a recent
+// triangle and introduce at most one vertex, so they cost a single code byte plus two
+// rotation bits. Vertex streams are delta coded per component, zigzag mapped and split into
+// byte planes so runs of all-zero high bytes can be skipped block by block.
+
+const int CODEC_EDGE_FIFO_SIZE = 15;   // Edge code 15 marks a triangle with no cached edge
+const int CODEC_VERTEX_FIFO_SIZE = 14; // Vertex codes: 0 = next, 1..14 = FIFO, 15 = explicit
+const int CODEC_VERTEX_BLOCK = 256;    // Vertices per byte-plane block
+
+// Shared encoder/decoder state; both sides must apply identical updates
+struct IndexCodecState {
+    unsigned int edgeA[16], edgeB[16];
+    unsigned int fifoVertex[16];
+    int edgeHead = 0;
+    int vertexHead = 0;
+    unsigned int next = 0;         // Predicted index of the next new vertex
+    unsigned int lastExplicit = 0; // Base for explicit vertex deltas
+
+    IndexCodecState() {
+        memset(edgeA, 0xff, sizeof(edgeA));
+        memset(edgeB, 0xff, sizeof(edgeB));
+        memset(fifoVertex, 0xff, sizeof(fifoVertex));
+    }
+
+    unsigned int vertexAt(int i) const { return fifoVertex[(vertexHead - 1 - i) & 15]; }
+
+    int findVertex(unsigned int v) const {
+        for (int i = 0; i < CODEC_VERTEX_FIFO_SIZE; i++) {
+            if (vertexAt(i) == v) return i;
+        }
+        return -1;
+    }
+
+    int findEdge(unsigned int a, unsigned int b) const {
+        for (int i = 0; i < CODEC_EDGE_FIFO_SIZE; i++) {
+            int slot = (edgeHead - 1 - i) & 15;
+            if (edgeA[slot] == a && edgeB[slot] == b) return i;
+        }
+        return -1;
+    }
+
+    // Records the edges of a triangle as its neighbours will see them (reversed)
+    void pushTriangle(unsigned int a, unsigned int b, unsigned int c) {
+        edgeA[edgeHead & 15] = b; edgeB[edgeHead & 15] = a; edgeHead++;
+        edgeA[edgeHead & 15] = c; edgeB[edgeHead & 15] = b; edgeHead++;
+        edgeA[edgeHead & 15] = a; edgeB[edgeHead & 15] = c; edgeHead++;
+    }
+
+    // Bookkeeping after a vertex has been resolved from its 4-bit code
+    void resolved(unsigned int v, int code) {
+        if (code == 0 || code == 15) {
+            fifoVertex[vertexHead & 15] = v;
+            vertexHead++;
+        }
+        if (code == 15) lastExplicit = v;
+        if (v >= next) next = v + 1;
+    }
+};
+
+void codecPutU32(std::vector<unsigned char>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back((value >> (8 * i)) & 0xff);
+}
+
+uint32_t codecGetU32(const unsigned char* data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+void codecPutVarint(std::vector<unsigned char>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+// Encodes one vertex and returns its 4-bit code
+int encodeIndexVertex(IndexCodecState& state, unsigned int v, std::vector<unsigned char>& explicitStream) {
+    int code;
+    if (v == state.next) {
+        code = 0;
+    } else {
+        int k = state.findVertex(v);
+        if (k >= 0) {
+            code = k + 1;
+        } else {
+            code = 15;
+            int32_t delta = (int32_t)(v - state.lastExplicit);
+            codecPutVarint(explicitStream, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+        }
+    }
+    state.resolved(v, code);
+    return code;
+}
+
+/**
+ * Compresses a triangle list. Triangle order and corner order are preserved exactly.
+ * Layout: u32 code bytes, u32 rotation bytes, u32 explicit bytes, then the three streams.
+ * @param indices Triangle indices
+ * @param indexCount Number of indices (multiple of 3)
+ * @return Encoded bytes
+ */
+std::vector<unsigned char> encodeIndexBuffer(const unsigned int* indices, size_t indexCount) {
+    IndexCodecState state;
+    std::vector<unsigned char> codes, rotations, explicitStream;
+    codes.reserve(indexCount / 3 + 16);
+    rotations.reserve(indexCount / 12 + 1);
+    int rotationCount = 0;
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        const unsigned int* t = indices + i;
+
+        // Look for an edge of the triangle, in any rotation, among recent edges
+        int edge = -1, rotation = 0;
+        for (int r = 0; r < 3 && edge < 0; r++) {
+            edge = state.findEdge(t[r], t[(r + 1) % 3]);
+            rotation = r;
+        }
+
+        if (edge >= 0) {
+            int code = encodeIndexVertex(state, t[(rotation + 2) % 3], explicitStream);
+            codes.push_back((unsigned char)((edge << 4) | code));
+            if ((rotationCount & 3) == 0) rotations.push_back(0);
+            rotations.back() |= rotation << (2 * (rotationCount & 3));
+            rotationCount++;
+        } else {
+            int codeA = encodeIndexVertex(state, t[0], explicitStream);
+            int codeB = encodeIndexVertex(state, t[1], explicitStream);
+            int codeC = encodeIndexVertex(state, t[2], explicitStream);
+            codes.push_back((unsigned char)(0xf0 | codeA));
+            codes.push_back((unsigned char)((codeB << 4) | codeC));
+        }
+        state.pushTriangle(t[0], t[1], t[2]);
+    }
+
+    std::vector<unsigned char> out;
+    out.reserve(12 + codes.size() + rotations.size() + explicitStream.size());
+    codecPutU32(out, codes.size());
+    codecPutU32(out, rotations.size());
+    codecPutU32(out, explicitStream.size());
+    out.insert(out.end(), codes.begin(), codes.end());
+    out.insert(out.end(), rotations.begin(), rotations.end());
+    out.insert(out.end(), explicitStream.begin(), explicitStream.end());
+    return out;
+}
+
+/**
+ * Decompresses a triangle list produced by encodeIndexBuffer.
+ * @param out Destination for indexCount indices
+ * @param indexCount Number of indices to decode
+ * @param data Encoded bytes
+ * @param size Size of the encoded data
+ * @return true on success, false if the data is truncated or malformed
+ */
+bool decodeIndexBuffer(unsigned int* out, size_t indexCount, const unsigned char* data, size_t size) {
+    if (size < 12) return false;
+    size_t codeSize = codecGetU32(data);
+    size_t rotationSize = codecGetU32(data + 4);
+    size_t explicitSize = codecGetU32(data + 8);
+    if (12 + codeSize + rotationSize + explicitSize > size) return false;
+
+    const unsigned char* code = data + 12;
+    const unsigned char* codeEnd = code + codeSize;
+    const unsigned char* rotation = codeEnd;
+    const unsigned char* rotationEnd = rotation + rotationSize;
+    const unsigned char* explicitData = rotationEnd;
+    const unsigned char* explicitEnd = explicitData + explicitSize;
+    int rotationCount = 0;
+
+    IndexCodecState state;
+
+    // Resolves a 4-bit vertex code; returns false when the explicit stream runs out
+    auto readVertex = [&](int c, unsigned int& v) {
+        if (c == 0) {
+            v = state.next;
+        } else if (c < 15) {
+            v = state.vertexAt(c - 1);
+        } else {
+            uint32_t z = 0;
+            int shift = 0;
+            for (;;) {
+                if (explicitData == explicitEnd || shift > 28) return false;
+                unsigned char byte = *explicitData++;
+                z |= (uint32_t)(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) break;
+                shift += 7;
+            }
+            v = state.lastExplicit + (uint32_t)((z >> 1) ^ (0u - (z & 1)));
+        }
+        state.resolved(v, c);
+        return true;
+    };
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        if (code == codeEnd) return false;
+        int byte = *code++;
+        int edge = byte >> 4;
+        unsigned int* t = out + i;
+
+        if (edge < CODEC_EDGE_FIFO_SIZE) {
+            if (rotation == rotationEnd) return false;
+            int r = (*rotation >> (2 * (rotationCount & 3))) & 3;
+            if ((++rotationCount & 3) == 0) rotation++;
+            if (r > 2) return false;
+
+            int slot = (state.edgeHead - 1 - edge) & 15;
+            unsigned int third;
+            if (!readVertex(byte & 15, third)) return false;
+            t[r] = state.edgeA[slot];
+            t[(r + 1) % 3] = state.edgeB[slot];
+            t[(r + 2) % 3] = third;
+        } else {
+            if (code == codeEnd) return false;
+            int codes = *code++;
+            if (!readVertex(byte & 15, t[0]) ||
+                !readVertex(codes >> 4, t[1]) ||
+                !readVertex(codes & 15, t[2])) {
+                return false;
+            }
+        }
+        state.pushTriangle(t[0], t[1], t[2]);
+    }
+    return true;
+}
+
+/**
+ * Compresses an interleaved stream of 32-bit attribute words (e.g. float positions).
+ * Each component is delta coded against the previous vertex, zigzag mapped and split into
+ * four byte planes per block; planes that are entirely zero are stored as a single byte.
+ * @param words Interleaved attribute data (vertexCount * components words)
+ * @param vertexCount Number of vertices
+ * @param components Words per vertex
+ * @return Encoded bytes
+ */
+std::vector<unsigned char> encodeVertexStream(const uint32_t* words, size_t vertexCount, int components) {
+    std::vector<unsigned char> out;
+    out.reserve(vertexCount * components * 4 / 2 + 64);
+    std::vector<uint32_t> zigzag(CODEC_VERTEX_BLOCK);
+    std::vector<uint32_t> previous(components, 0);
+
+    for (size_t blockStart = 0; blockStart < vertexCount; blockStart += CODEC_VERTEX_BLOCK) {
+        size_t blockSize = std::min<size_t>(CODEC_VERTEX_BLOCK, vertexCount - blockStart);
+
+        for (int c = 0; c < components; c++) {
+            uint32_t last = previous[c];
+            uint32_t nonZero = 0;
+            for (size_t i = 0; i < blockSize; i++) {
+                uint32_t w = words[(blockStart + i) * components + c];
+                int32_t delta = (int32_t)(w - last);
+                zigzag[i] = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+                nonZero |= zigzag[i];
+                last = w;
+            }
+            previous[c] = last;
+
+            for (int plane = 0; plane < 4; plane++) {
+                if (((nonZero >> (8 * plane)) & 0xff) == 0) {
+                    out.push_back(0);
+                    continue;
+                }
+                out.push_back(1);
+                for (size_t i = 0; i < blockSize; i++) {
+                    out.push_back((zigzag[i] >> (8 * plane)) & 0xff);
+                }
+            }
+        }
+    }
+    return out;
+}
+
+/**
+ * Decompresses a stream produced by encodeVertexStream.
+ * @return true on success, false if the data is truncated or malformed
+ */
+bool decodeVertexStream(uint32_t* words, size_t vertexCount, int components, const unsigned char* data, size_t size) {
+    const unsigned char* end = data + size;
+    uint32_t zigzag[CODEC_VERTEX_BLOCK];
+    std::vector<uint32_t> previous(components, 0);
+
+    for (size_t blockStart = 0; blockStart < vertexCount; blockStart += CODEC_VERTEX_BLOCK) {
+        size_t blockSize = std::min<size_t>(CODEC_VERTEX_BLOCK, vertexCount - blockStart);
+
+        for (int c = 0; c < components; c++) {
+            memset(zigzag, 0, sizeof(zigzag));
+            for (int plane = 0; plane < 4; plane++) {
+                if (data == end) return false;
+                unsigned char mode = *data++;
+                if (mode == 0) continue;
+                if (mode != 1 || (size_t)(end - data) < blockSize) return false;
+                if (blockSize == CODEC_VERTEX_BLOCK) {
+                    // Constant trip count so the loop vectorises at -O2
+                    for (int i = 0; i < CODEC_VERTEX_BLOCK; i++) {
+                        zigzag[i] |= (uint32_t)data[i] << (8 * plane);
+                    }
+                } else {
+                    for (size_t i = 0; i < blockSize; i++) {
+                        zigzag[i] |= (uint32_t)data[i] << (8 * plane);
+                    }
+                }
+                data += blockSize;
+            }
+
+            uint32_t last = previous[c];
+            uint32_t* dst = words + blockStart * components + c;
+            for (size_t i = 0; i < blockSize; i++) {
+                last += (zigzag[i] >> 1) ^ (0u - (zigzag[i] & 1));
+                dst[i * components] = last;
+            }
+            previous[c] = last;
+        }
+    }
+    return data == end;
+}
+
+#endif // MESH_CODEC_H
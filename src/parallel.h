@@ -0,0 +1,167 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of threads used for data-parallel loops
+unsigned int workerCount() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+// Persistent worker threads for data-parallel loops. The calling thread takes part in every
+// job, so a pool of n - 1 workers keeps n cores busy without spawning threads per call.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threads) {
+        for (unsigned int i = 0; i < threads; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Threads that execute a job, the caller included
+    unsigned int size() const { return (unsigned int)workers.size() + 1; }
+
+    // Splits [begin, end) into chunks and calls invoke(context, chunkBegin, chunkEnd) for
+    // each one on the pool and the calling thread. Blocks until every chunk has run.
+    // The callable is passed by pointer so dispatching a job never allocates.
+    void run(int begin, int end, int chunks, void (*invoke)(void*, int, int), void* context) {
+        std::lock_guard<std::mutex> runLock(runMutex); // One job at a time
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = invoke;
+            jobContext = context;
+            jobBegin = begin;
+            jobEnd = end;
+            jobChunks = chunks;
+            nextChunk = 0;
+            remaining = chunks;
+            jobId++;
+        }
+        wake.notify_all();
+
+        // The caller runs chunks too; a parallelFor inside them must not re-enter run()
+        insideJob() = true;
+        executeChunks();
+        insideJob() = false;
+
+        // Wait for chunks still running and for workers to leave the job
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return remaining == 0 && active == 0; });
+        job = nullptr;
+    }
+
+    // True on pool worker threads, where nested loops must run inline
+    static bool onWorkerThread() { return insideWorker(); }
+
+    // True on the thread that called run() while it executes chunks of that job
+    static bool onJobCaller() { return insideJob(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    bool stopping = false;
+
+    // Current job; written under mutex before jobId changes
+    void (*job)(void*, int, int) = nullptr;
+    void* jobContext = nullptr;
+    int jobBegin = 0, jobEnd = 0, jobChunks = 0;
+    unsigned long jobId = 0;
+    std::atomic<int> nextChunk{0};
+    std::atomic<int> remaining{0};
+    int active = 0; // Workers inside executeChunks, guarded by mutex
+
+    static bool& insideWorker() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+
+    static bool& insideJob() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+
+    void executeChunks() {
+        int count = jobEnd - jobBegin;
+        for (;;) {
+            int chunk = nextChunk.fetch_add(1);
+            if (chunk >= jobChunks) break;
+
+            int chunkBegin = jobBegin + (int)((long long)count * chunk / jobChunks);
+            int chunkEnd = jobBegin + (int)((long long)count * (chunk + 1) / jobChunks);
+            job(jobContext, chunkBegin, chunkEnd);
+
+            if (remaining.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+
+    void workerLoop() {
+        insideWorker() = true;
+        unsigned long seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || (job != nullptr && jobId != seen); });
+                if (stopping) return;
+                seen = jobId;
+                active++;
+            }
+
+            executeChunks();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+            finished.notify_all();
+        }
+    }
+};
+
+// Pool shared by all parallel loops, created on first use
+ThreadPool& threadPool() {
+    static ThreadPool pool(workerCount() - 1);
+    return pool;
+}
+
+// Splits [begin, end) into one contiguous chunk per pool thread and calls
+// fn(chunkBegin, chunkEnd) for each chunk. Ranges smaller than minChunk, and loops nested
+// inside another parallel loop (on a worker or on its calling thread), run inline.
+template <typename Fn>
+void parallelFor(int begin, int end, Fn fn, int minChunk = 16384) {
+    int count = end - begin;
+    if (count <= 0) return;
+
+    int threads = std::min<int>(workerCount(), (count + minChunk - 1) / minChunk);
+    if (threads <= 1 || ThreadPool::onWorkerThread() || ThreadPool::onJobCaller()) {
+        fn(begin, end);
+        return;
+    }
+
+    ThreadPool& pool = threadPool();
+    pool.run(begin, end, std::min<int>(threads, pool.size()),
+             [](void* context, int chunkBegin, int chunkEnd) { (*static_cast<Fn*>(context))(chunkBegin, chunkEnd); },
+             &fn);
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,250 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU timing zones. PROFILE_ZONE("name") times the rest of the enclosing scope;
+// zones nest, and each thread records into its own ring so recording never takes a lock.
+// The viewer shows the rings as a flame graph and can export them for chrome://tracing.
+//
+// Needs no GL context, so CPU-only code such as the explosion kernel can be instrumented;
+// GPU zones live in gpu_profiler.h.
+
+struct ProfileEvent {
+    const char* name; // String literal; only the pointer is stored
+    int64_t startNs;  // Since the profiler was created
+    int64_t endNs;
+    int depth;        // Nesting level on its thread, 0 for the outermost zone
+};
+
+// Events of one thread, oldest overwritten first. Only the owning thread writes; readers
+// copy without locking and afterwards drop the entries the writer may have reached.
+struct ProfilerThread {
+    static constexpr uint64_t RING_SIZE = 8192; // Power of two
+
+    ProfileEvent events[RING_SIZE];
+    std::atomic<uint64_t> head{0}; // Events written so far
+    std::atomic<bool> retired{false};
+    std::string name;
+    int id = 0;
+    int depth = 0; // Open zones; touched by the owning thread only
+
+    void push(const ProfileEvent& event) {
+        uint64_t index = head.load(std::memory_order_relaxed);
+        events[index & (RING_SIZE - 1)] = event;
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    // Appends the events that ended at or after sinceNs, oldest first
+    void copy(std::vector<ProfileEvent>& out, int64_t sinceNs) const {
+        // Events are pushed as their zones close, so end times only grow on a thread and
+        // the scan can stop at the first event that is too old
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t begin = end > RING_SIZE ? end - RING_SIZE : 0;
+        std::vector<ProfileEvent> newestFirst;
+        for (uint64_t i = end; i > begin; i--) {
+            const ProfileEvent& event = events[(i - 1) & (RING_SIZE - 1)];
+            if (event.endNs < sinceNs) break;
+            newestFirst.push_back(event);
+        }
+
+        // Slots the writer reused while they were copied may be torn
+        uint64_t after = head.load(std::memory_order_acquire);
+        uint64_t valid = after > RING_SIZE ? after - RING_SIZE : 0;
+        for (size_t k = newestFirst.size(); k-- > 0;) {
+            if (end - 1 - k >= valid) out.push_back(newestFirst[k]);
+        }
+    }
+};
+
+// Recent events of one thread, copied out of its ring
+struct ProfilerTrack {
+    int id;
+    std::string name;
+    std::vector<ProfileEvent> events;
+};
+
+class Profiler {
+public:
+    static constexpr int FRAME_HISTORY = 128;
+
+    std::atomic<bool> enabled{true};
+
+    Profiler() : epoch(std::chrono::steady_clock::now()) {}
+
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // Ring of the calling thread, registered on first use
+    ProfilerThread& thread();
+
+    void setThreadName(const std::string& name) {
+        ProfilerThread& current = thread();
+        std::lock_guard<std::mutex> lock(mutex);
+        current.name = name;
+    }
+
+    /**
+     * Ring for events recorded on behalf of something that is not a thread, e.g. the GPU.
+     * Only one thread may push to it.
+     */
+    ProfilerThread& addTrack(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return *registerThread(name);
+    }
+
+    // Marks the start of a frame; called by the render loop only
+    void markFrame() {
+        if (!enabled.load(std::memory_order_relaxed)) return;
+        frameStarts[frameCount % FRAME_HISTORY] = now();
+        frameCount++;
+    }
+
+    /**
+     * Time span of a completed frame.
+     * @param age 0 for the most recently completed frame, 1 for the one before, ...
+     * @return false if that frame is no longer (or not yet) in the history
+     */
+    bool frameRange(int age, int64_t& start, int64_t& end) const {
+        if (age < 0 || age + 2 > FRAME_HISTORY || frameCount < (uint64_t)age + 2) return false;
+        uint64_t last = frameCount - 1 - age;
+        start = frameStarts[(last - 1) % FRAME_HISTORY];
+        end = frameStarts[last % FRAME_HISTORY];
+        return true;
+    }
+
+    // Copies the recent events of every thread that ended at or after sinceNs
+    std::vector<ProfilerTrack> snapshot(int64_t sinceNs = INT64_MIN) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<ProfilerTrack> tracks;
+        for (ProfilerThread* t : threads) {
+            ProfilerTrack track{t->id, t->name, {}};
+            t->copy(track.events, sinceNs);
+            if (!track.events.empty()) tracks.push_back(std::move(track));
+        }
+        return tracks;
+    }
+
+    /**
+     * Writes every event still in the rings in the Trace Event format read by
+     * chrome://tracing and Perfetto.
+     * @return true if the file was written
+     */
+    bool exportChromeTrace(const std::string& path) {
+        std::vector<ProfilerTrack> tracks = snapshot();
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) return false;
+        fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        bool first = true;
+        for (const ProfilerTrack& track : tracks) {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                    first ? "" : ",\n", track.id, track.name.c_str());
+            first = false;
+            for (const ProfileEvent& event : track.events) {
+                fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                        event.name, track.id, event.startNs / 1000.0, (event.endNs - event.startNs) / 1000.0);
+            }
+        }
+        fprintf(file, "\n]}\n");
+        return fclose(file) == 0;
+    }
+
+private:
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex mutex; // Guards the thread list and ring reuse, never taken while recording
+    std::vector<ProfilerThread*> threads;
+    int nextId = 1;
+    int64_t frameStarts[FRAME_HISTORY] = {0};
+    uint64_t frameCount = 0;
+
+    // std::async starts a thread per call, so rings of exited threads are reused. The last
+    // few are kept so short-lived work such as the mesh load stays in exported traces.
+    // Rings are never freed: pool workers may still record while globals are destroyed.
+    ProfilerThread* registerThread(const std::string& name) {
+        const int KEPT_RETIRED = 4;
+        ProfilerThread* ring = nullptr;
+        int retiredCount = 0;
+        for (ProfilerThread* t : threads) {
+            if (!t->retired.load()) continue;
+            retiredCount++;
+            if (!ring || t->id < ring->id) ring = t;
+        }
+        if (retiredCount <= KEPT_RETIRED) {
+            ring = nullptr;
+        }
+        if (!ring) {
+            ring = new ProfilerThread();
+            threads.push_back(ring);
+        }
+        ring->head.store(0);
+        ring->retired.store(false);
+        ring->depth = 0;
+        ring->id = nextId++;
+        ring->name = name.empty() ? "Thread " + std::to_string(ring->id) : name;
+        return ring;
+    }
+};
+
+Profiler profiler;
+
+// Releases the calling thread's ring for reuse when the thread exits
+struct ProfilerThreadSlot {
+    ProfilerThread* ring = nullptr;
+    ~ProfilerThreadSlot() {
+        if (ring) ring->retired.store(true);
+    }
+};
+
+thread_local ProfilerThreadSlot profilerThreadSlot;
+
+ProfilerThread& Profiler::thread() {
+    if (!profilerThreadSlot.ring) {
+        std::lock_guard<std::mutex> lock(mutex);
+        profilerThreadSlot.ring = registerThread("");
+    }
+    return *profilerThreadSlot.ring;
+}
+
+// Times its own lifetime on the calling thread
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name(name) {
+        if (!profiler.enabled.load(std::memory_order_relaxed)) return;
+        ring = &profiler.thread();
+        depth = ring->depth++;
+        start = profiler.now();
+    }
+
+    ~ProfileZone() { end(); }
+
+    // Closes the zone before the end of its scope, for sequential phases in one block
+    void end() {
+        if (!ring) return;
+        ring->depth--;
+        ring->push({name, start, profiler.now(), depth});
+        ring = nullptr;
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    ProfilerThread* ring = nullptr;
+    int64_t start = 0;
+    int depth = 0;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+
+#endif // PROFILER_H
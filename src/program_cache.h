@@ -0,0 +1,179 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include "../glad/glad.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "gl_extensions.h"
+
+// On-disk cache of linked program binaries (shader_cache/<key>.progbin).
+//
+// The key hashes both shader sources together with the GL vendor, renderer and version
+// strings, so a driver update or a different GPU never sees a stale binary. Drivers may
+// still reject a binary (e.g. after an update that keeps the version string); the entry is
+// then deleted and the program is compiled from source.
+//
+// Layout (little endian u32 unless noted):
+//   magic, version, key (u64), binary format, binary length, binary bytes.
+
+const uint32_t PROGRAM_CACHE_MAGIC = 0x47505243; // "CRPG"
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+const size_t PROGRAM_CACHE_HEADER_SIZE = 24;
+
+// Set by initProgramCache when the context can return program binaries; cleared by
+// --no-shader-cache
+bool programCacheEnabled = false;
+std::string programCacheDirectory = "shader_cache";
+
+// 64-bit FNV-1a, chained over several strings to build a cache key
+uint64_t programCacheHash(const std::string& text, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Enables the cache if the context supports program binaries, loading the entry points
+ * from GL_ARB_get_program_binary when the core 4.1 ones were not loaded.
+ * @param load GL function loader, as passed to gladLoadGLLoader
+ * @return true if binaries can be saved and restored
+ */
+bool initProgramCache(GLADloadproc load) {
+    if (!glad_glGetProgramBinary || !glad_glProgramBinary || !glad_glProgramParameteri) {
+        if (hasGLExtension("GL_ARB_get_program_binary")) {
+            glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+            glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+            glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+        }
+    }
+
+    int formats = 0;
+    if (glad_glGetProgramBinary && glad_glProgramBinary && glad_glProgramParameteri) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    programCacheEnabled = formats > 0;
+    return programCacheEnabled;
+}
+
+/**
+ * Cache key of a program built from the given sources on the current context.
+ * @param sources Every shader source of the program, in a fixed order
+ * @return 64-bit key used as the cache file name
+ */
+uint64_t programCacheKey(const std::vector<std::string>& sources) {
+    uint64_t key = programCacheHash(std::to_string(PROGRAM_CACHE_VERSION));
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        const char* value = (const char*)glGetString(name);
+        key = programCacheHash(value ? value : "", key);
+        key = programCacheHash("\n", key);
+    }
+    for (const std::string& source : sources) {
+        key = programCacheHash(std::to_string(source.size()), key);
+        key = programCacheHash(source, key);
+    }
+    return key;
+}
+
+std::string programCachePath(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.progbin", (unsigned long long)key);
+    return programCacheDirectory + "/" + name;
+}
+
+/**
+ * Restores a linked program from the cache. A binary the driver rejects is removed so
+ * the next launch writes a fresh one.
+ * @param program Program object with no shaders attached
+ * @return true if the program is linked and ready to use
+ */
+bool loadProgramBinary(unsigned int program, uint64_t key) {
+    if (!programCacheEnabled) return false;
+
+    std::string path = programCachePath(key);
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    size_t fileSize = in.tellg();
+    if (fileSize < PROGRAM_CACHE_HEADER_SIZE) return false;
+    in.seekg(0);
+
+    std::vector<unsigned char> data(fileSize);
+    if (!in.read((char*)data.data(), fileSize)) return false;
+    in.close();
+
+    uint32_t header[6];
+    memcpy(header, data.data(), sizeof(header));
+    uint64_t storedKey = header[2] | ((uint64_t)header[3] << 32);
+    GLenum format = header[4];
+    uint32_t length = header[5];
+    if (header[0] != PROGRAM_CACHE_MAGIC || header[1] != PROGRAM_CACHE_VERSION ||
+        storedKey != key || length != fileSize - PROGRAM_CACHE_HEADER_SIZE) {
+        std::remove(path.c_str());
+        return false;
+    }
+
+    glProgramBinary(program, format, data.data() + PROGRAM_CACHE_HEADER_SIZE, length);
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        std::cout << "Program binary rejected by the driver, recompiling: " << path << std::endl;
+        std::remove(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the binary of a linked program to the cache. Failures are not fatal; the program
+ * is simply compiled again on the next launch.
+ * @param program Linked program created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+ * @return true if the binary was written
+ */
+bool saveProgramBinary(unsigned int program, uint64_t key) {
+    if (!programCacheEnabled) return false;
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return false;
+
+    std::vector<unsigned char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) return false;
+
+    uint32_t header[6] = {PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, (uint32_t)key,
+                          (uint32_t)(key >> 32), (uint32_t)format, (uint32_t)written};
+
+    std::error_code ec;
+    std::filesystem::create_directories(programCacheDirectory, ec);
+    if (ec) return false;
+
+    // Write to a temporary file first so a crash never leaves a truncated binary behind
+    std::string cachePath = programCachePath(key);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary);
+        if (!out) return false;
+        out.write((const char*)header, sizeof(header));
+        out.write((const char*)binary.data(), written);
+        if (!out) {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath, cachePath, ec);
+    return !ec;
+}
+
+#endif // PROGRAM_CACHE_H
@@ -0,0 +1,23 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+// Draw submissions of the current frame, counted where the draw calls are issued. The
+// render loop resets the counters at the start of every frame.
+struct RenderStats {
+    int drawCalls = 0;
+    long long triangles = 0;
+
+    void reset() {
+        drawCalls = 0;
+        triangles = 0;
+    }
+
+    void addDraw(long long drawTriangles) {
+        drawCalls++;
+        triangles += drawTriangles;
+    }
+};
+
+RenderStats renderStats;
+
+#endif // RENDER_STATS_H
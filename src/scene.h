@@ -0,0 +1,294 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "../glad/glad.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "gl_extensions.h"
+#include "frustum_culling.h"
+#include "render_stats.h"
+#include "profiler.h"
+
+// Many OFF models drawn as one. Every mesh is appended to a shared vertex arena and a
+// shared index arena; its indices stay relative to its own first vertex, so a draw only
+// needs the mesh's base vertex and first index. The whole scene lives in one VAO and is
+// submitted with a single multi-draw, either indirect from a command buffer or with
+// glMultiDrawElementsBaseVertex.
+//
+// Meshes are scaled to unit size and laid out on a grid in the XY plane when loaded, so
+// one model matrix places the whole scene. Scenes are drawn at rest; the explode effects
+// need per-mesh part data and remain with the single-mesh viewer.
+
+// Where one mesh lives in the arenas
+struct SceneMesh {
+    std::string name;
+    GLint baseVertex;  // Added to each of the mesh's indices
+    GLuint firstIndex; // Position of its first index in the index arena
+    GLsizei indexCount;
+    CullBounds bounds; // In scene space
+};
+
+// Command layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+class Scene {
+public:
+    std::vector<SceneMesh> meshes;
+    std::vector<MeshVertex> vertices; // Vertex arena
+    std::vector<unsigned int> indices; // Index arena
+    float boundingSphereRadius = 1.0f; // Of the whole grid, centered on the origin
+    CullStats cullStats;
+
+    /**
+     * Expands the paths given on the command line: directories contribute their .off
+     * files in name order, other paths are taken as they are.
+     */
+    static std::vector<std::string> expandPaths(const std::vector<std::string>& paths) {
+        std::vector<std::string> files;
+        for (const std::string& path : paths) {
+            std::error_code ec;
+            if (!std::filesystem::is_directory(path, ec)) {
+                files.push_back(path);
+                continue;
+            }
+            std::vector<std::string> found;
+            for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+                std::string extension = entry.path().extension().string();
+                std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+                if (entry.is_regular_file(ec) && extension == ".off") {
+                    found.push_back(entry.path().string());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+        return files;
+    }
+
+    // Loads and packs every file; CPU work only, the GL buffers are made by setupScene
+    explicit Scene(const std::vector<std::string>& filenames) {
+        PROFILE_ZONE("Scene load");
+        int columns = (int)std::ceil(std::sqrt((double)filenames.size()));
+        int rows = ((int)filenames.size() + columns - 1) / std::max(columns, 1);
+        const float spacing = 2.5f; // Between cell centers; each mesh fits a unit sphere
+
+        // OFFReader tokenizes with strtok, so the files are read one after another
+        for (size_t m = 0; m < filenames.size(); m++) {
+            OffModel* model = loadOffModel(filenames[m]);
+            if (!model) {
+                throw std::runtime_error("Failed to load OFF file: " + filenames[m]);
+            }
+            glm::vec3 cell((m % columns - (columns - 1) * 0.5f) * spacing,
+                           ((rows - 1) * 0.5f - (int)(m / columns)) * spacing, 0.0f);
+            append(filenames[m], model, cell);
+            FreeOffModel(model);
+        }
+
+        // Half diagonal of the grid plus a cell's own radius
+        boundingSphereRadius = 0.5f * spacing * std::sqrt((float)((columns - 1) * (columns - 1) + (rows - 1) * (rows - 1))) + 1.0f;
+
+        std::vector<CullBounds> bounds(meshes.size());
+        for (size_t m = 0; m < meshes.size(); m++) bounds[m] = meshes[m].bounds;
+        meshBVH.build(bounds);
+    }
+
+    ~Scene() {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &commandBuffer);
+    }
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // Uploads the arenas into one VAO
+    void setupScene() {
+        PROFILE_ZONE("Scene upload");
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+        glBindVertexArray(0);
+
+        if (multiDrawIndirect) {
+            glGenBuffers(1, &commandBuffer);
+            useIndirect = true;
+        }
+        drawsDirty = true;
+    }
+
+    // Same convention as Mesh::getModelMatrix; the grid is already centered and unit sized per cell
+    glm::mat4 getModelMatrix(float rotationAngle, glm::vec3 rotationAxis) const {
+        glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / boundingSphereRadius));
+        return glm::rotate(model, glm::radians(rotationAngle), rotationAxis);
+    }
+
+    /**
+     * Picks the meshes the next Draw submits.
+     * @param frustum Frustum in scene space (from projection * view * model), or NULL to
+     *                draw every mesh
+     */
+    void cull(const Frustum* frustum) {
+        cullStats = CullStats();
+        std::vector<int>& visible = culledMeshes;
+        visible.clear();
+        if (frustum) {
+            meshBVH.cull(*frustum, visible, cullStats);
+            // Submitting in arena order keeps the vertex fetches moving forward
+            std::sort(visible.begin(), visible.end());
+        } else {
+            visible.resize(meshes.size());
+            for (size_t m = 0; m < meshes.size(); m++) visible[m] = (int)m;
+        }
+        if (visible != visibleMeshes) {
+            visibleMeshes.swap(visible);
+            drawsDirty = true;
+        }
+    }
+
+    // Draws the meshes picked by the last cull() with one multi-draw. The draw arrays, and
+    // the command buffer for indirect draws, are rebuilt only when that set changes.
+    void Draw(Shader& shader) {
+        shader.setFloat(shader.explodeDistanceLocation, 0.0f);
+        if (drawsDirty) buildDraws();
+        if (visibleMeshes.empty()) return;
+
+        glBindVertexArray(VAO);
+        if (useIndirect && commandBuffer) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, (GLsizei)commands.size(), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        } else {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+                                          (GLsizei)drawCounts.size(), drawBaseVertices.data());
+        }
+        glBindVertexArray(0);
+        renderStats.addDraw(visibleTriangles);
+    }
+
+    // Switching the submission path rebuilds the draws for the other one
+    void setIndirect(bool indirect) {
+        indirect = indirect && commandBuffer != 0;
+        if (indirect != useIndirect) {
+            useIndirect = indirect;
+            drawsDirty = true;
+        }
+    }
+
+    bool supportsIndirect() const { return commandBuffer != 0; }
+
+    size_t triangleCount() const { return indices.size() / 3; }
+
+    size_t arenaBytes() const {
+        return vertices.size() * sizeof(MeshVertex) + indices.size() * sizeof(unsigned int);
+    }
+
+private:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int commandBuffer = 0; // GL_DRAW_INDIRECT_BUFFER of the visible meshes
+    CullingBVH meshBVH;
+    std::vector<int> visibleMeshes;
+    std::vector<int> culledMeshes;  // Scratch for the next visible set
+    bool useIndirect = false;       // Submit through the command buffer
+    bool drawsDirty = true;
+    long long visibleTriangles = 0;
+
+    // Arguments of the multi-draw, one entry per visible mesh
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+    std::vector<GLint> drawBaseVertices;
+
+    // Appends a model to the arenas, centered on cell and scaled to a unit sphere
+    void append(const std::string& name, const OffModel* model, const glm::vec3& cell) {
+        SceneMesh mesh;
+        mesh.name = name;
+        mesh.baseVertex = (GLint)vertices.size();
+        mesh.firstIndex = (GLuint)indices.size();
+
+        glm::vec3 center((model->minX + model->maxX) / 2.0f, (model->minY + model->maxY) / 2.0f,
+                         (model->minZ + model->maxZ) / 2.0f);
+        float scale = model->extent > 0.0f ? 2.0f / model->extent : 1.0f;
+        glm::vec3 min(INFINITY), max(-INFINITY);
+        for (int i = 0; i < model->numberOfVertices; i++) {
+            glm::vec3 position(model->vertices[i].x, model->vertices[i].y, model->vertices[i].z);
+            MeshVertex vertex;
+            vertex.position = (position - center) * scale + cell;
+            vertex.normal = glm::vec3(0.0f);
+            vertices.push_back(vertex);
+            min = glm::min(min, vertex.position);
+            max = glm::max(max, vertex.position);
+        }
+
+        // Same triangulation and normals as a Mesh of the file; indices stay mesh-relative
+        MeshVertex* base = vertices.data() + mesh.baseVertex;
+        triangulatePolygons(model, indices);
+        accumulateVertexNormals(base, model->numberOfVertices, indices.data() + mesh.firstIndex,
+                                indices.size() - mesh.firstIndex);
+
+        mesh.indexCount = (GLsizei)(indices.size() - mesh.firstIndex);
+        float radius = 0.0f;
+        glm::vec3 sphereCenter = (min + max) * 0.5f;
+        for (int i = 0; i < model->numberOfVertices; i++) {
+            radius = std::max(radius, glm::length(base[i].position - sphereCenter));
+        }
+        mesh.bounds = {min, max, sphereCenter, radius};
+        meshes.push_back(mesh);
+    }
+
+    void buildDraws() {
+        commands.clear();
+        drawCounts.clear();
+        drawOffsets.clear();
+        drawBaseVertices.clear();
+        visibleTriangles = 0;
+        for (int m : visibleMeshes) {
+            const SceneMesh& mesh = meshes[m];
+            if (useIndirect) {
+                commands.push_back({(GLuint)mesh.indexCount, 1, mesh.firstIndex, mesh.baseVertex, 0});
+            } else {
+                drawCounts.push_back(mesh.indexCount);
+                drawOffsets.push_back((const void*)(mesh.firstIndex * sizeof(unsigned int)));
+                drawBaseVertices.push_back(mesh.baseVertex);
+            }
+            visibleTriangles += mesh.indexCount / 3;
+        }
+        if (useIndirect) {
+            // Orphaned on every change; the set changes with the view, not every frame
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand),
+                         commands.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        drawsDirty = false;
+    }
+};
+
+#endif // SCENE_H
@@ -4,17 +4,52 @@
 #include "../glad/glad.h"
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <utility>
+#include <vector>
+#include "profiler.h"
+#include "program_cache.h"
+#include "uniform_blocks.h"
+
+// FNV-1a hash of a uniform name, usable in constant expressions
+constexpr uint32_t uniformHash(const char* name, uint32_t hash = 2166136261u) {
+    return *name ? uniformHash(name + 1, (hash ^ (uint8_t)*name) * 16777619u) : hash;
+}
+
+// Uniform name reduced to its hash. The hash is only guaranteed to be folded at compile
+// time where the name is a constant expression, such as a constexpr UniformName; a literal
+// passed straight to a setter is usually hashed at run time. Either way the lookup is a
+// table search, so uniforms set on every draw go through the locations cached below.
+struct UniformName {
+    uint32_t hash;
+
+    constexpr UniformName(const char* name) : hash(uniformHash(name)) {}
+    UniformName(const std::string& name) : hash(uniformHash(name.c_str())) {}
+};
 
 class Shader {
 public:
     unsigned int ID;
+    bool linked = false;          // Whether the program linked and can be used
+    bool loadedFromCache = false; // Restored from the program binary cache instead of compiled
+    double buildMs = 0.0;         // Time from starting the build to finishing it
+
+    // Locations of the uniforms set on every draw, read once per program by finish()
+    int explodeTimeLocation = -1;
+    int explodeDistanceLocation = -1;
 
-    // Constructor reads and builds the shader
-    Shader(const char* vertexPath, const char* fragmentPath) {
+    // Constructor reads and builds the shader. defines are inserted after the #version line
+    // of both stages to specialise the program, see shader_variants.h. With wait = false the
+    // compile and link are only issued; the driver may run them on its own threads (see
+    // parallelShaderCompile) until finish() is called.
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "", bool wait = true) {
+        PROFILE_ZONE("Shader build");
         // 1. Retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -47,34 +82,92 @@ public:
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
 
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
+        injectDefines(vertexCode, defines);
+        injectDefines(fragmentCode, defines);
 
-        // 2. Compile shaders
-        unsigned int vertex, fragment;
+        buildStart = std::chrono::high_resolution_clock::now();
 
-        // Vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        // 2. Restore the linked program from the binary cache, or compile and link it
+        cacheKey = programCacheKey({vertexCode, fragmentCode});
+        ID = glCreateProgram();
+        loadedFromCache = loadProgramBinary(ID, cacheKey);
+        if (!loadedFromCache) {
+            PROFILE_ZONE("Shader compile");
+            const char* vShaderCode = vertexCode.c_str();
+            const char* fShaderCode = fragmentCode.c_str();
 
-        // Fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+            // Vertex shader
+            vertexShader = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(vertexShader, 1, &vShaderCode, NULL);
+            glCompileShader(vertexShader);
 
-        // Shader program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+            // Fragment Shader
+            fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(fragmentShader, 1, &fShaderCode, NULL);
+            glCompileShader(fragmentShader);
+
+            // Shader program; errors are checked in finish() so the link is not waited on here
+            if (programCacheEnabled) {
+                glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            }
+            glAttachShader(ID, vertexShader);
+            glAttachShader(ID, fragmentShader);
+            glLinkProgram(ID);
+        }
 
-        // Delete shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        if (wait) finish();
+    }
+
+    // Whether the build was started with wait = false and not finished yet
+    bool pending() const {
+        return !finished;
+    }
+
+    // Whether finish() can complete without waiting for the driver. Without parallel shader
+    // compile there is no way to ask, so this reports true and finish() may block.
+    bool ready() const {
+        if (finished || loadedFromCache || !parallelShaderCompile) return true;
+        int done = 0;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done != 0;
+    }
+
+    // Completes the build: reports compile and link errors, stores the program binary and
+    // reads the uniform locations
+    void finish() {
+        if (finished) return;
+        finished = true;
+        PROFILE_ZONE("Shader finish");
+
+        linked = loadedFromCache;
+        if (!loadedFromCache) {
+            checkCompileErrors(vertexShader, "VERTEX");
+            checkCompileErrors(fragmentShader, "FRAGMENT");
+            linked = checkCompileErrors(ID, "PROGRAM");
+            if (linked) {
+                saveProgramBinary(ID, cacheKey);
+            }
+
+            // Delete shaders as they're linked into our program now and no longer necessary
+            deleteShaders();
+        }
+
+        // A restored binary starts from default uniform state, so block bindings are assigned
+        // on both paths along with the location table
+        reflectUniforms();
+        bindUniformBlocks();
+        explodeTimeLocation = location("explodeTime");
+        explodeDistanceLocation = location("explodeDistance");
+
+        buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+    }
+
+    // Deletes the program, including a build that is still pending
+    void destroy() {
+        deleteShaders();
+        glDeleteProgram(ID);
+        ID = 0;
+        linked = false;
     }
 
     // Activate the shader
@@ -82,58 +175,199 @@ public:
         glUseProgram(ID);
     }
 
-    // Utility uniform functions
-    void setBool(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    // Location of an active uniform, or -1 if the program does not use it. Locations are
+    // stable until the program is relinked, so callers can look them up once and keep them
+    // as handles for the int overloads below.
+    int location(UniformName name) const {
+        auto it = std::lower_bound(locations.begin(), locations.end(), std::make_pair(name.hash, INT32_MIN));
+        return it != locations.end() && it->first == name.hash ? it->second : -1;
+    }
+
+    // Utility uniform functions, by name or by location handle
+    void setBool(UniformName name, bool value) const {
+        glUniform1i(location(name), (int)value);
+    }
+
+    void setBool(int location, bool value) const {
+        glUniform1i(location, (int)value);
+    }
+
+    void setInt(UniformName name, int value) const {
+        glUniform1i(location(name), value);
+    }
+
+    void setInt(int location, int value) const {
+        glUniform1i(location, value);
+    }
+
+    void setFloat(UniformName name, float value) const {
+        glUniform1f(location(name), value);
+    }
+
+    void setFloat(int location, float value) const {
+        glUniform1f(location, value);
+    }
+
+    void setVec2(UniformName name, const glm::vec2& value) const {
+        glUniform2fv(location(name), 1, &value[0]);
+    }
+
+    void setVec2(int location, const glm::vec2& value) const {
+        glUniform2fv(location, 1, &value[0]);
+    }
+
+    void setVec2(UniformName name, float x, float y) const {
+        glUniform2f(location(name), x, y);
     }
 
-    void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    void setVec2(int location, float x, float y) const {
+        glUniform2f(location, x, y);
     }
 
-    void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    void setVec3(UniformName name, const glm::vec3& value) const {
+        glUniform3fv(location(name), 1, &value[0]);
     }
 
-    void setVec2(const std::string& name, const glm::vec2& value) const {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec3(int location, const glm::vec3& value) const {
+        glUniform3fv(location, 1, &value[0]);
     }
 
-    void setVec2(const std::string& name, float x, float y) const {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    void setVec3(UniformName name, float x, float y, float z) const {
+        glUniform3f(location(name), x, y, z);
     }
 
-    void setVec3(const std::string& name, const glm::vec3& value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec3(int location, float x, float y, float z) const {
+        glUniform3f(location, x, y, z);
     }
 
-    void setVec3(const std::string& name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    void setVec4(UniformName name, const glm::vec4& value) const {
+        glUniform4fv(location(name), 1, &value[0]);
     }
 
-    void setVec4(const std::string& name, const glm::vec4& value) const {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec4(int location, const glm::vec4& value) const {
+        glUniform4fv(location, 1, &value[0]);
     }
 
-    void setVec4(const std::string& name, float x, float y, float z, float w) const {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    void setVec4(UniformName name, float x, float y, float z, float w) const {
+        glUniform4f(location(name), x, y, z, w);
     }
 
-    void setMat2(const std::string& name, const glm::mat2& mat) const {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    void setVec4(int location, float x, float y, float z, float w) const {
+        glUniform4f(location, x, y, z, w);
     }
 
-    void setMat3(const std::string& name, const glm::mat3& mat) const {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    void setMat2(UniformName name, const glm::mat2& mat) const {
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
-    void setMat4(const std::string& name, const glm::mat4& mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    void setMat2(int location, const glm::mat2& mat) const {
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void setMat3(UniformName name, const glm::mat3& mat) const {
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void setMat3(int location, const glm::mat3& mat) const {
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void setMat4(UniformName name, const glm::mat4& mat) const {
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void setMat4(int location, const glm::mat4& mat) const {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
-    // Utility function for checking shader compilation/linking errors
-    void checkCompileErrors(unsigned int shader, std::string type) {
+    std::vector<std::pair<uint32_t, int>> locations; // (name hash, location), sorted by hash
+    unsigned int vertexShader = 0;   // Stage objects of a build that is not finished
+    unsigned int fragmentShader = 0;
+    uint64_t cacheKey = 0;
+    bool finished = false;
+    std::chrono::high_resolution_clock::time_point buildStart;
+
+    void deleteShaders() {
+        if (vertexShader) {
+            glDetachShader(ID, vertexShader);
+            glDeleteShader(vertexShader);
+            vertexShader = 0;
+        }
+        if (fragmentShader) {
+            glDetachShader(ID, fragmentShader);
+            glDeleteShader(fragmentShader);
+            fragmentShader = 0;
+        }
+    }
+
+    // Reads every active uniform once after linking into the flat location table.
+    // Array elements are registered individually and the array name maps to element 0.
+    void reflectUniforms() {
+        locations.clear();
+        std::vector<std::string> names;
+
+        int count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        for (int i = 0; i < count; i++) {
+            char buffer[256];
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, i, sizeof(buffer), &length, &size, &type, buffer);
+            std::string name(buffer, length);
+
+            // Members of uniform blocks have no location
+            if (glGetUniformLocation(ID, name.c_str()) < 0) continue;
+
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                std::string base = name.substr(0, name.size() - 3);
+                names.push_back(base);
+                for (int element = 0; element < size; element++) {
+                    names.push_back(base + "[" + std::to_string(element) + "]");
+                }
+            } else {
+                names.push_back(name);
+            }
+        }
+
+        for (const std::string& name : names) {
+            locations.emplace_back(uniformHash(name.c_str()), glGetUniformLocation(ID, name.c_str()));
+        }
+        std::sort(locations.begin(), locations.end());
+
+        for (size_t i = 1; i < locations.size(); i++) {
+            if (locations[i].first == locations[i - 1].first && locations[i].second != locations[i - 1].second) {
+                std::cout << "WARNING::SHADER: uniform name hash collision, lookups may be wrong" << std::endl;
+            }
+        }
+    }
+
+    // Inserts defines after the #version line; the #line directive keeps compiler messages
+    // pointing at the lines of the file
+    static void injectDefines(std::string& source, const std::string& defines) {
+        if (defines.empty()) return;
+        size_t position = 0;
+        if (source.compare(0, 8, "#version") == 0) {
+            size_t end = source.find('\n');
+            position = end == std::string::npos ? source.size() : end + 1;
+        }
+        int line = position > 0 ? 2 : 1;
+        source.insert(position, defines + "#line " + std::to_string(line) + "\n");
+    }
+
+    // Attaches the shared uniform blocks the program declares to their binding points
+    void bindUniformBlocks() {
+        for (const UniformBlockBinding& block : UNIFORM_BLOCK_BINDINGS) {
+            unsigned int index = glGetUniformBlockIndex(ID, block.name);
+            if (index != GL_INVALID_INDEX) {
+                glUniformBlockBinding(ID, index, block.binding);
+            }
+        }
+    }
+
+    // Utility function for checking shader compilation/linking errors; returns true on success
+    bool checkCompileErrors(unsigned int shader, std::string type) {
         int success;
         char infoLog[1024];
         if (type != "PROGRAM") {
@@ -150,6 +384,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
 #endif
\ No newline at end of file
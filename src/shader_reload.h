@@ -0,0 +1,144 @@
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include "../glad/glad.h"
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "file_watcher.h"
+#include "shader_variants.h"
+
+// Rebuilds the shader variants in the background whenever a shader file changes.
+//
+// Programs are compiled on a worker thread that owns a hidden window whose context shares
+// objects with the main one, so the render loop keeps drawing with the current programs
+// meanwhile. The new set replaces the old one only when every variant linked; after a
+// failed edit the previous programs stay in use until the next save.
+class ShaderReloader {
+public:
+    bool reloading = false;     // A rebuild is running on the worker
+    bool lastReloadOk = true;   // Outcome of the most recent rebuild
+    double lastReloadMs = 0.0;  // Wall time of the most recent rebuild
+    int reloadCount = 0;        // Rebuilds swapped in so far
+
+    ShaderReloader() = default;
+    ShaderReloader(const ShaderReloader&) = delete;
+    ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+    ~ShaderReloader() { stop(); }
+
+    /**
+     * Starts watching a shader directory. Must be called on the main thread, which owns
+     * window creation in GLFW.
+     * @param mainWindow Window whose context the worker shares programs with
+     * @return false if hot reload is unavailable; the viewer runs without it
+     */
+    bool start(GLFWwindow* mainWindow, const std::string& directory) {
+        if (!watcher.watch(directory, ".glsl")) {
+            std::cout << "Shader hot reload disabled: cannot watch " << directory << std::endl;
+            return false;
+        }
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        workerWindow = glfwCreateWindow(1, 1, "shader compiler", NULL, mainWindow);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (!workerWindow) {
+            std::cout << "Shader hot reload disabled: no shared context" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Waits for a running rebuild and destroys the worker context. Call before glfwTerminate.
+    void stop() {
+        if (build.valid()) build.wait();
+        if (workerWindow) {
+            glfwDestroyWindow(workerWindow);
+            workerWindow = NULL;
+        }
+    }
+
+    /**
+     * Called once per frame on the main thread. Starts a rebuild when a shader file changed
+     * and swaps in a finished one. Never waits for the worker.
+     * @return true if new programs were swapped in this frame
+     */
+    bool update(ShaderVariants& variants) {
+        if (!workerWindow) return false;
+        pending |= watcher.poll();
+
+        bool swapped = false;
+        if (reloading && build.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            Result result = build.get();
+            reloading = false;
+            lastReloadOk = result.ok;
+            lastReloadMs = result.ms;
+            if (result.ok) {
+                variants.replace(std::move(result.programs));
+                reloadCount++;
+                swapped = true;
+                std::cout << "Shaders reloaded in " << result.ms << " ms" << std::endl;
+            } else {
+                std::cout << "Shader reload failed; keeping the previous programs" << std::endl;
+            }
+        }
+
+        // Saves that land during a rebuild start another one once it finishes
+        if (pending && !reloading) {
+            pending = false;
+            reloading = true;
+            std::vector<ShaderFeatures> features = variants.features();
+            build = std::async(std::launch::async, [this, &variants, features]() {
+                return compile(variants, features);
+            });
+        }
+        return swapped;
+    }
+
+private:
+    struct Result {
+        std::map<uint32_t, std::unique_ptr<Shader>> programs;
+        bool ok = true;
+        double ms = 0.0;
+    };
+
+    FileWatcher watcher;
+    GLFWwindow* workerWindow = NULL;
+    std::future<Result> build;
+    bool pending = false;
+
+    // Runs on the worker: builds every requested variant on the shared context
+    Result compile(const ShaderVariants& variants, const std::vector<ShaderFeatures>& features) {
+        auto start = std::chrono::high_resolution_clock::now();
+        profiler.setThreadName("Shader reload");
+        PROFILE_ZONE("Shader reload");
+        glfwMakeContextCurrent(workerWindow);
+
+        Result result;
+        for (const ShaderFeatures& f : features) {
+            std::unique_ptr<Shader> shader = variants.compile(f);
+            result.ok &= shader->linked;
+            result.programs[f.key()] = std::move(shader);
+            if (!result.ok) break;
+        }
+        if (!result.ok) {
+            for (const auto& program : result.programs) {
+                program.second->destroy();
+            }
+            result.programs.clear();
+        }
+
+        // The main context may use the programs as soon as the result is published
+        glFinish();
+        glfwMakeContextCurrent(NULL);
+        result.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        return result;
+    }
+};
+
+#endif // SHADER_RELOAD_H
@@ -0,0 +1,172 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "shader.h"
+
+// Feature set a program is specialised for. Every feature becomes a #define, so disabled
+// features are compiled out instead of being branched over per vertex and fragment.
+struct ShaderFeatures {
+    // Number of distinct explode variants: at rest plus one per ExplodeMode
+    static constexpr int EXPLODE_VARIANTS = 4;
+
+    bool depthColor = false; // Color by view depth instead of the material color
+    int explodeMode = -1;    // ExplodeMode the vertex shader applies, or -1 for a mesh at rest
+    bool instanced = false;  // Per-instance transforms from the instance vertex stream
+
+    uint32_t key() const {
+        return (depthColor ? 1u : 0u) | (uint32_t)(explodeMode + 1) << 1 | (instanced ? 8u : 0u);
+    }
+
+    static ShaderFeatures fromKey(uint32_t key) {
+        ShaderFeatures features;
+        features.depthColor = (key & 1u) != 0;
+        features.explodeMode = (int)((key >> 1) & 3u) - 1;
+        features.instanced = (key & 8u) != 0;
+        return features;
+    }
+
+    // Preprocessor lines injected into both stages
+    std::string defines() const {
+        std::string result;
+        if (depthColor) result += "#define DEPTH_COLOR\n";
+        if (explodeMode >= 0) result += "#define EXPLODE_MODE " + std::to_string(explodeMode) + "\n";
+        if (instanced) result += "#define INSTANCED\n";
+        return result;
+    }
+
+    // Short label for logs
+    std::string name() const {
+        std::string result = depthColor ? "depth color" : "material color";
+        result += explodeMode >= 0 ? ", explode mode " + std::to_string(explodeMode) : ", at rest";
+        if (instanced) result += ", instanced";
+        return result;
+    }
+};
+
+// Programs built from one vertex/fragment pair, one per feature set. Variants are compiled
+// the first time they are requested, or all at once by startAll when the driver compiles in
+// parallel; precompileNext finishes or builds the remaining ones one per call so that
+// toggling a feature later does not stall a frame. The program binary cache makes all of
+// this nearly free after the first launch.
+class ShaderVariants {
+public:
+    /**
+     * @param setup Called once on each new program while it is in use, e.g. to assign
+     *              sampler units
+     */
+    ShaderVariants(const char* vertexPath, const char* fragmentPath, std::function<void(Shader&)> setup)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), setup(std::move(setup)) {}
+
+    // Program for a feature set, built on first use or finished if it is still compiling
+    Shader& get(const ShaderFeatures& features) {
+        auto it = variants.find(features.key());
+        if (it == variants.end()) return build(features);
+        if (it->second->pending()) complete(*it->second, features);
+        return *it->second;
+    }
+
+    // Issues the compile of every variant not built yet without waiting for any of them.
+    // Only useful with parallelShaderCompile; otherwise drivers compile each one in turn.
+    void startAll() {
+        for (uint32_t key = 0; key < (uint32_t)count(); key++) {
+            if (variants.count(key) == 0) {
+                variants[key] = compile(ShaderFeatures::fromKey(key), false);
+            }
+        }
+    }
+
+    /**
+     * Finishes one started variant whose compile is done, or else builds one that has not
+     * been requested yet. Leaves the previously used program unbound, so callers activate
+     * their program afterwards.
+     * @return true if a variant was finished or built
+     */
+    bool precompileNext() {
+        bool compiling = false;
+        for (auto& variant : variants) {
+            if (!variant.second->pending()) continue;
+            if (variant.second->ready()) {
+                complete(*variant.second, ShaderFeatures::fromKey(variant.first));
+                return true;
+            }
+            compiling = true;
+        }
+        if (compiling) return false;
+
+        for (uint32_t key = 0; key < (uint32_t)count(); key++) {
+            if (variants.count(key) == 0) {
+                build(ShaderFeatures::fromKey(key));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Builds a variant from the current files without registering it. Uses only state fixed
+     * at construction, so a worker thread with a shared context may call it.
+     * @param wait false to only issue the compile; finish it with complete()
+     * @return The new program; check Shader::linked before using it
+     */
+    std::unique_ptr<Shader> compile(const ShaderFeatures& features, bool wait = true) const {
+        std::unique_ptr<Shader> shader(new Shader(vertexPath.c_str(), fragmentPath.c_str(), features.defines(), wait));
+        if (wait) complete(*shader, features);
+        return shader;
+    }
+
+    // Finishes a build and prepares the program for drawing
+    void complete(Shader& shader, const ShaderFeatures& features) const {
+        shader.finish();
+        if (shader.linked) {
+            shader.use();
+            if (setup) setup(shader);
+        }
+
+        std::cout << "Shader variant (" << features.name() << ") " << (shader.loadedFromCache ? "loaded from cache" : "compiled")
+                  << " in " << shader.buildMs << " ms" << std::endl;
+    }
+
+    // Feature sets of every variant built so far
+    std::vector<ShaderFeatures> features() const {
+        std::vector<ShaderFeatures> result;
+        for (const auto& variant : variants) {
+            result.push_back(ShaderFeatures::fromKey(variant.first));
+        }
+        return result;
+    }
+
+    // Swaps in a complete set of programs and deletes the ones they replace. Variants
+    // missing from the new set are rebuilt on demand.
+    void replace(std::map<uint32_t, std::unique_ptr<Shader>> newVariants) {
+        for (const auto& variant : variants) {
+            variant.second->destroy();
+        }
+        variants = std::move(newVariants);
+    }
+
+    size_t size() const { return variants.size(); }
+    static constexpr int count() { return 4 * ShaderFeatures::EXPLODE_VARIANTS; }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::function<void(Shader&)> setup;
+    std::map<uint32_t, std::unique_ptr<Shader>> variants;
+
+    Shader& build(const ShaderFeatures& features) {
+        std::unique_ptr<Shader> shader = compile(features);
+        Shader& result = *shader;
+        variants[features.key()] = std::move(shader);
+        return result;
+    }
+};
+
+#endif // SHADER_VARIANTS_H
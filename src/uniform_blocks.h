@@ -0,0 +1,122 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include "../glad/glad.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+// Uniform blocks shared by every program. Each block lives in one buffer bound to a fixed
+// binding point, so one upload per frame serves all shaders and meshes.
+
+// Binding points; Shader assigns them to the blocks of every program it links
+const unsigned int FRAME_BLOCK_BINDING = 0;
+const unsigned int LIGHT_BLOCK_BINDING = 1;
+const unsigned int MATERIAL_BLOCK_BINDING = 2;
+const unsigned int OBJECT_BLOCK_BINDING = 3;
+
+// Block name and binding point of each shared block
+struct UniformBlockBinding {
+    const char* name;
+    unsigned int binding;
+};
+
+const UniformBlockBinding UNIFORM_BLOCK_BINDINGS[] = {
+    {"FrameBlock", FRAME_BLOCK_BINDING},
+    {"LightBlock", LIGHT_BLOCK_BINDING},
+    {"MaterialBlock", MATERIAL_BLOCK_BINDING},
+    {"ObjectBlock", OBJECT_BLOCK_BINDING},
+};
+
+// std140 mirrors of the GLSL blocks. vec3 members take 16 bytes unless followed by a scalar
+// that fills their fourth component.
+struct FrameBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;
+    float minDepth;
+    float maxDepth;
+    float padding[3];
+};
+
+// Clustered lighting parameters; the lights themselves live in texture buffers
+struct LightBlock {
+    glm::uvec4 clusterDims;   // Froxel grid x, y, z and the number of lights
+    glm::vec4 clusterScale;   // Viewport width, height, depth slice scale and bias
+};
+
+// Depth coloring is a shader variant rather than a material flag, see shader_variants.h
+struct MaterialBlock {
+    glm::vec3 objectColor;
+    float shininess;
+};
+
+// Per-draw transforms. The normal matrix is computed once per draw on the CPU; std140
+// stores a mat3 as three vec4 columns.
+struct ObjectBlock {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3];
+};
+
+static_assert(sizeof(FrameBlock) == 160, "FrameBlock must match the std140 layout");
+static_assert(sizeof(LightBlock) == 32, "LightBlock must match the std140 layout");
+static_assert(sizeof(MaterialBlock) == 16, "MaterialBlock must match the std140 layout");
+static_assert(sizeof(ObjectBlock) == 112, "ObjectBlock must match the std140 layout");
+
+// CPU copy of a block plus the byte range changed since the last upload
+template <typename Block>
+class UniformBuffer {
+public:
+    Block data;
+
+    UniformBuffer() { memset((void*)&data, 0, sizeof(Block)); }
+
+    ~UniformBuffer() {
+        if (buffer) glDeleteBuffers(1, &buffer);
+    }
+
+    // Creates the buffer with the current contents and binds it to its binding point
+    void create(unsigned int binding) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &data, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        dirtyBegin = sizeof(Block);
+        dirtyEnd = 0;
+    }
+
+    // Stores value in a member of data and marks it dirty if it changed
+    template <typename T>
+    void set(T& member, const T& value) {
+        if (memcmp(&member, &value, sizeof(T)) == 0) return;
+        member = value;
+        markDirty(&member, sizeof(T));
+    }
+
+    // Marks bytes of data as changed, e.g. after writing a member directly
+    void markDirty(const void* member, size_t size) {
+        size_t offset = (const char*)member - (const char*)&data;
+        dirtyBegin = std::min(dirtyBegin, offset);
+        dirtyEnd = std::max(dirtyEnd, offset + size);
+    }
+
+    // Uploads the changed range, if any; returns whether anything was sent
+    bool upload() {
+        if (dirtyEnd <= dirtyBegin) return false;
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, dirtyBegin, dirtyEnd - dirtyBegin, (const char*)&data + dirtyBegin);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        dirtyBegin = sizeof(Block);
+        dirtyEnd = 0;
+        return true;
+    }
+
+private:
+    unsigned int buffer = 0;
+    size_t dirtyBegin = sizeof(Block);
+    size_t dirtyEnd = 0;
+};
+
+#endif // UNIFORM_BLOCKS_H